@@ -11,149 +11,256 @@
  * \date February 14 2017
  */
 
+#include "kernels.h"
+#include "mat4.h"
+#include "objloader.h"
+#include "pack.h"
+#include "raster.h"
+#include "ubo.h"
 #include <GL4D/gl4duw_SDL2.h>
 #include <SDL_image.h>
 #include <assert.h>
+#include <math.h>
+#include <strings.h>
 
 #include <assimp/cimport.h>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
 
-/* the global Assimp scene object */
+/* the global Assimp scene object, only alive while loading */
 static const struct aiScene *_scene = NULL;
 static struct aiVector3D _scene_min, _scene_max, _scene_center;
 
 #define aisgl_min(x, y) (x < y ? x : y)
 #define aisgl_max(x, y) (y > x ? y : x)
 
-static void get_bounding_box_for_node(const struct aiNode *nd,
-                                      struct aiVector3D *min,
-                                      struct aiVector3D *max,
-                                      struct aiMatrix4x4 *trafo);
+/* classement des matériaux pour l'ordre de dessin : en deçà de ALPHA_LOW
+ * un texel est transparent, au delà de ALPHA_HIGH opaque ; une texture
+ * dont plus de ALPHA_PARTIAL_MAX des texels sont entre les deux est
+ * translucide, sinon un simple test alpha (seuil ALPHA_TEST) suffit */
+#define ALPHA_LOW 8
+#define ALPHA_HIGH 247
+#define ALPHA_PARTIAL_MAX 0.1
+#define ALPHA_TEST 0.5f
+
+/* listes de dessin : celle d'une frame est préparée pendant que la
+ * précédente est soumise */
+#define NB_SLOTS 2
+
+enum { MATERIAL_OPAQUE = 0, MATERIAL_ALPHA_TEST, MATERIAL_TRANSLUCENT };
+
+/* matériau et maillage tels que chargés, indépendamment du chargeur (Assimp
+ * ou objLoad) ; les couleurs sont lues une fois pour toutes au chargement */
+typedef struct material_t material_t;
+struct material_t {
+  GLfloat diffuse[4], specular[4], ambient[4], emission[4];
+  GLfloat shininess, opacity;
+  int alphaMode; /* MATERIAL_OPAQUE, _ALPHA_TEST ou _TRANSLUCENT */
+  char texture[BUFSIZ]; /* chaîne vide si pas de texture diffuse */
+};
+
+typedef struct mesh_t mesh_t;
+struct mesh_t {
+  GLfloat *vertices; /* positions, normales puis coordonnées de texture */
+  GLuint *indices;
+  GLuint nbVertices, count, material;
+  int hasNormals, hasTexCoords;
+  /* nœud vers racine, lignes majeures comme mat4Mult */
+  GLfloat transform[16];
+  /* sphère englobante (centre de la boîte), pour le tri et l'élimination
+   * hors champ */
+  GLfloat center[3], radius;
+};
+
+/* maillage à dessiner, profondeur de son centre dans le repère vue et
+ * bloc de matrices associé dans le tampon uniforme de la frame */
+typedef struct drawItem_t drawItem_t;
+struct drawItem_t {
+  GLfloat depth;
+  GLuint mesh, object;
+};
+
+/* fichier de l'archive des ressources lu par Assimp */
+typedef struct memFile_t memFile_t;
+struct memFile_t {
+  struct aiFile file; /* en premier : l'aiFile reçu est le memFile_t */
+  const char *data;
+  size_t size, pos;
+};
+
 static void get_bounding_box(struct aiVector3D *min, struct aiVector3D *max);
 static void color4_to_float4(const struct aiColor4D *c, float f[4]);
 static void set_float4(float f[4], float a, float b, float c, float d);
-static void apply_material(const struct aiMaterial *mtl);
-static void sceneMkVAOs(const struct aiScene *sc, const struct aiNode *nd,
-                        GLuint *ivao);
-static void sceneDrawVAOs(const struct aiScene *sc, const struct aiNode *nd,
-                          GLuint *ivao);
+static void get_material(const struct aiMaterial *mtl, material_t *m);
+static void apply_material(const material_t *m);
+static void sceneCollect(const struct aiScene *sc, const struct aiNode *nd,
+                         struct aiMatrix4x4 *trafo);
+static void sceneMkVAOs(void);
+static void scenePrepare(int slot, const GLfloat *proj, const GLfloat *mv,
+                         uboFrame *f, unsigned int base);
+static void frustumPlanes(const GLfloat *proj, GLfloat planes[6][4]);
+static void sceneDrawVAOs(int slot);
+static void sceneDrawMesh(GLint id, const drawItem_t *it);
+static int frontToBack(const void *a, const void *b);
+static int backToFront(const void *a, const void *b);
+static void classifyMaterial(material_t *m, SDL_Surface *t);
+static void meshCenter(mesh_t *m);
+static void sceneRasterVAOs(void);
 static int sceneNbMeshes(const struct aiScene *sc, const struct aiNode *nd,
                          int subtotal);
 static int loadasset(const char *path);
-
-static GLuint *_vaos = NULL, *_buffers = NULL, *_counts = NULL,
-              *_textures = NULL, _nbMeshes = 0, _nbTextures = 0;
+static int loadobj(const char *path);
+static void initAsset(const char *filename);
+static SDL_Surface *loadMaterialTexture(const material_t *m,
+                                        const char *filename);
+static void meshPack(const struct aiMesh *mesh, mesh_t *m);
+static void freeMeshData(void);
+static struct aiFile *memOpen(struct aiFileIO *io, const char *name,
+                              const char *mode);
+static void memClose(struct aiFileIO *io, struct aiFile *f);
+static size_t memRead(struct aiFile *f, char *buf, size_t size, size_t count);
+static size_t memWrite(struct aiFile *f, const char *buf, size_t size,
+                       size_t count);
+static size_t memTell(struct aiFile *f);
+static size_t memSize(struct aiFile *f);
+static enum aiReturn memSeek(struct aiFile *f, size_t offset,
+                             enum aiOrigin origin);
+static void memFlush(struct aiFile *f);
+
+static GLuint *_vaos = NULL, *_buffers = NULL, *_textures = NULL,
+              _nbMeshes = 0, _nbTextures = 0;
+static mesh_t *_meshes = NULL;
+static material_t *_materials = NULL;
+/* ordre de dessin par emplacement : _nbOpaque opaques au début,
+ * _nbTranslucent translucides à la fin */
+static drawItem_t *_order[NB_SLOTS];
+static int _nbOpaque[NB_SLOTS], _nbTranslucent[NB_SLOTS];
+/* pile de la préparation, propre au thread qui l'exécute */
+static unsigned int _prepStack = 0;
+/* passe de profondeur seule avant les opaques, désactivable via
+ * SQUARES_DEPTH_PREPASS=0 */
+static int _depthPrepass = 1;
+
+/* backend CPU : textures converties en RGBA 8 bits */
+static SDL_Surface **_rsurfaces = NULL;
+static rasterTexture *_rtextures = NULL;
 
 void assimpInit(const char *filename) {
   int i;
-  GLuint ivao = 0;
-  struct aiLogStream stream;
-  /* get a handle to the predefined STDOUT log stream and attach
-     it to the logging system. It remains active for all further
-     calls to aiImportFile(Ex) and aiApplyPostProcessing. */
-  stream = aiGetPredefinedLogStream(aiDefaultLogStream_STDOUT, NULL);
-  aiAttachLogStream(&stream);
-  /* ... same procedure, but this stream now writes the
-     log messages to assimp_log.txt */
-  stream = aiGetPredefinedLogStream(aiDefaultLogStream_FILE, "assimp_log.txt");
-  aiAttachLogStream(&stream);
-  /* the model name can be specified on the command line. If none
-     is specified, we try to locate one of the more expressive test
-     models from the repository (/models-nonbsd may be missing in
-     some distributions so we need a fallback from /models!). */
-  if (loadasset(filename) != 0) {
-    fprintf(stderr, "Erreur lors du chargement du fichier %s\n", filename);
-    exit(3);
-  }
+  initAsset(filename);
   /* XXX docs say all polygons are emitted CCW, but tests show that some aren't.
    */
   if (getenv("MODEL_IS_BROKEN"))
     glFrontFace(GL_CW);
 
-  _textures = malloc((_nbTextures = _scene->mNumMaterials) * sizeof *_textures);
+  _textures = malloc(_nbTextures * sizeof *_textures);
   assert(_textures);
 
   glGenTextures(_nbTextures, _textures);
 
-  for (i = 0; i < _scene->mNumMaterials; i++) {
-    const struct aiMaterial *pMaterial = _scene->mMaterials[i];
-    if (aiGetMaterialTextureCount(pMaterial, aiTextureType_DIFFUSE) > 0) {
-      struct aiString tfname;
-      char *dir = pathOf(filename), buf[BUFSIZ];
-      if (aiGetMaterialTexture(pMaterial, aiTextureType_DIFFUSE, 0, &tfname,
-                               NULL, NULL, NULL, NULL, NULL,
-                               NULL) == AI_SUCCESS) {
-        SDL_Surface *t;
-        snprintf(buf, sizeof buf, "%s/%s", dir, tfname.data);
-
-        if (!(t = IMG_Load(buf))) {
-          fprintf(stderr, "Probleme de chargement de textures %s\n", buf);
-          fprintf(stderr, "\tNouvel essai avec %s\n", tfname.data);
-          if (!(t = IMG_Load(tfname.data))) {
-            fprintf(stderr, "Probleme de chargement de textures %s\n",
-                    tfname.data);
-            continue;
-          }
-        }
-        glBindTexture(GL_TEXTURE_2D, _textures[i]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
-                        GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
-                        GL_REPEAT);
+  for (i = 0; i < _nbTextures; i++) {
+    SDL_Surface *t = loadMaterialTexture(&_materials[i], filename);
+    classifyMaterial(&_materials[i], t);
+    if (!t)
+      continue;
+    glBindTexture(GL_TEXTURE_2D, _textures[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 #ifdef __APPLE__
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, t->w, t->h, 0,
-                     t->format->BytesPerPixel == 3 ? GL_BGR : GL_BGRA,
-                     GL_UNSIGNED_BYTE, t->pixels);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, t->w, t->h, 0,
+                 t->format->BytesPerPixel == 3 ? GL_BGR : GL_BGRA,
+                 GL_UNSIGNED_BYTE, t->pixels);
 #else
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, t->w, t->h, 0,
-                     t->format->BytesPerPixel == 3 ? GL_RGB : GL_RGBA,
-                     GL_UNSIGNED_BYTE, t->pixels);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, t->w, t->h, 0,
+                 t->format->BytesPerPixel == 3 ? GL_RGB : GL_RGBA,
+                 GL_UNSIGNED_BYTE, t->pixels);
 #endif
-        SDL_FreeSurface(t);
-      }
-    }
+    SDL_FreeSurface(t);
   }
 
-  _nbMeshes = sceneNbMeshes(_scene, _scene->mRootNode, 0);
   _vaos = malloc(_nbMeshes * sizeof *_vaos);
   assert(_vaos);
   glGenVertexArrays(_nbMeshes, _vaos);
   _buffers = malloc(2 * _nbMeshes * sizeof *_buffers);
   assert(_buffers);
   glGenBuffers(2 * _nbMeshes, _buffers);
-  _counts = calloc(_nbMeshes, sizeof *_counts);
-  assert(_counts);
-  sceneMkVAOs(_scene, _scene->mRootNode, &ivao);
+  sceneMkVAOs();
+  /* les données sont maintenant côté GPU */
+  freeMeshData();
+  for (i = 0; i < NB_SLOTS; ++i) {
+    _order[i] = malloc(_nbMeshes * sizeof *_order[i]);
+    assert(_order[i]);
+    _nbOpaque[i] = _nbTranslucent[i] = 0;
+  }
+  _prepStack = mat4GenStack();
+  if (getenv("SQUARES_DEPTH_PREPASS"))
+    _depthPrepass = atoi(getenv("SQUARES_DEPTH_PREPASS")) != 0;
+}
+
+/* initialisation sans aucun appel OpenGL, pour le rasteriseur CPU */
+void assimpInitRaster(const char *filename) {
+  int i;
+  initAsset(filename);
+  _rsurfaces = calloc(_nbTextures, sizeof *_rsurfaces);
+  assert(_rsurfaces);
+  _rtextures = calloc(_nbTextures, sizeof *_rtextures);
+  assert(_rtextures);
+  for (i = 0; i < _nbTextures; i++) {
+    SDL_Surface *t;
+    if (!(t = loadMaterialTexture(&_materials[i], filename)))
+      continue;
+    _rsurfaces[i] = SDL_ConvertSurfaceFormat(t, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(t);
+    if (!_rsurfaces[i])
+      continue;
+    _rtextures[i].w = _rsurfaces[i]->w;
+    _rtextures[i].h = _rsurfaces[i]->h;
+    _rtextures[i].pitch = _rsurfaces[i]->pitch / 4;
+    _rtextures[i].texels = _rsurfaces[i]->pixels;
+  }
+}
+
+/* nombre de blocs de matrices à réserver pour assimpPrepareScene */
+unsigned int assimpNbMeshes(void) { return _nbMeshes; }
+
+/* prépare dans slot la liste de dessin sous la vue mv : élimination hors
+ * champ, tri et matrices de chaque maillage, rangées dans les blocs base et
+ * suivants de f. Aucun appel OpenGL, peut tourner sur un worker */
+void assimpPrepareScene(int slot, const float *proj, const float *mv,
+                        uboFrame *f, unsigned int base) {
+  GLfloat tmp;
+  assert(slot >= 0 && slot < NB_SLOTS);
+  tmp = _scene_max.x - _scene_min.x;
+  tmp = aisgl_max(_scene_max.y - _scene_min.y, tmp);
+  tmp = aisgl_max(_scene_max.z - _scene_min.z, tmp);
+  tmp = 1.0f / tmp;
+  mat4Load(_prepStack, mv);
+  mat4Scale(_prepStack, tmp, tmp, tmp);
+  mat4Translate(_prepStack, -_scene_center.x, -_scene_center.y,
+                -_scene_center.z);
+  scenePrepare(slot, proj, mat4Top(_prepStack), f, base);
 }
 
-void assimpDrawScene(void) {
+/* dessine la liste préparée dans slot, dont la frame a été envoyée */
+void assimpDrawScene(int slot) { sceneDrawVAOs(slot); }
+
+void assimpRasterScene(void) {
   GLfloat tmp;
-  GLuint ivao = 0;
   tmp = _scene_max.x - _scene_min.x;
   tmp = aisgl_max(_scene_max.y - _scene_min.y, tmp);
   tmp = aisgl_max(_scene_max.z - _scene_min.z, tmp);
   tmp = 1.0f / tmp;
-  gl4duScalef(tmp, tmp, tmp);
-  gl4duTranslatef(-_scene_center.x, -_scene_center.y, -_scene_center.z);
-  sceneDrawVAOs(_scene, _scene->mRootNode, &ivao);
+  rasterScale(tmp, tmp, tmp);
+  rasterTranslate(-_scene_center.x, -_scene_center.y, -_scene_center.z);
+  sceneRasterVAOs();
 }
 
 void assimpQuit(void) {
-  /* cleanup - calling 'aiReleaseImport' is important, as the library
-     keeps internal resources until the scene is freed again. Not
-     doing so can cause severe resource leaking. */
-  aiReleaseImport(_scene);
+  int i;
   /* We added a log stream to the library, it's our job to disable it
      again. This will definitely release the last resources allocated
      by Assimp.*/
   aiDetachAllLogStreams();
-  if (_counts) {
-    free(_counts);
-    _counts = NULL;
-  }
   if (_textures) {
     glDeleteTextures(_nbTextures, _textures);
     free(_textures);
@@ -169,33 +276,107 @@ void assimpQuit(void) {
     free(_buffers);
     _buffers = NULL;
   }
+  if (_meshes) {
+    freeMeshData();
+    free(_meshes);
+    _meshes = NULL;
+  }
+  if (_materials) {
+    free(_materials);
+    _materials = NULL;
+  }
+  for (i = 0; i < NB_SLOTS; ++i) {
+    free(_order[i]);
+    _order[i] = NULL;
+  }
+  if (_prepStack) {
+    mat4DeleteStack(_prepStack);
+    _prepStack = 0;
+  }
+  if (_rsurfaces) {
+    for (i = 0; i < _nbTextures; ++i)
+      if (_rsurfaces[i])
+        SDL_FreeSurface(_rsurfaces[i]);
+    free(_rsurfaces);
+    _rsurfaces = NULL;
+  }
+  if (_rtextures) {
+    free(_rtextures);
+    _rtextures = NULL;
+  }
 }
 
-static void get_bounding_box_for_node(const struct aiNode *nd,
-                                      struct aiVector3D *min,
-                                      struct aiVector3D *max,
-                                      struct aiMatrix4x4 *trafo) {
-  struct aiMatrix4x4 prev;
-  unsigned int n = 0, t;
-  prev = *trafo;
-  aiMultiplyMatrix4(trafo, &nd->mTransformation);
-  for (; n < nd->mNumMeshes; ++n) {
-    const struct aiMesh *mesh = _scene->mMeshes[nd->mMeshes[n]];
-    for (t = 0; t < mesh->mNumVertices; ++t) {
-      struct aiVector3D tmp = mesh->mVertices[t];
-      aiTransformVecByMatrix4(&tmp, trafo);
-      min->x = aisgl_min(min->x, tmp.x);
-      min->y = aisgl_min(min->y, tmp.y);
-      min->z = aisgl_min(min->z, tmp.z);
-      max->x = aisgl_max(max->x, tmp.x);
-      max->y = aisgl_max(max->y, tmp.y);
-      max->z = aisgl_max(max->z, tmp.z);
+static void initAsset(const char *filename) {
+  struct aiLogStream stream;
+  int i;
+  /* get a handle to the predefined STDOUT log stream and attach
+     it to the logging system. It remains active for all further
+     calls to aiImportFile(Ex) and aiApplyPostProcessing. */
+  stream = aiGetPredefinedLogStream(aiDefaultLogStream_STDOUT, NULL);
+  aiAttachLogStream(&stream);
+  /* ... same procedure, but this stream now writes the
+     log messages to assimp_log.txt */
+  stream = aiGetPredefinedLogStream(aiDefaultLogStream_FILE, "assimp_log.txt");
+  aiAttachLogStream(&stream);
+  /* the model name can be specified on the command line. If none
+     is specified, we try to locate one of the more expressive test
+     models from the repository (/models-nonbsd may be missing in
+     some distributions so we need a fallback from /models!). */
+  if (loadasset(filename) != 0) {
+    fprintf(stderr, "Erreur lors du chargement du fichier %s\n", filename);
+    exit(3);
+  }
+  for (i = 0; i < _nbMeshes; ++i)
+    meshCenter(&_meshes[i]);
+}
+
+static SDL_Surface *loadMaterialTexture(const material_t *m,
+                                        const char *filename) {
+  char *dir, buf[BUFSIZ];
+  SDL_Surface *t;
+  if (!m->texture[0])
+    return NULL;
+  dir = pathOf(filename);
+  snprintf(buf, sizeof buf, "%s/%s", dir, m->texture);
+  if (!(t = IMG_Load_RW(packRW(buf), 1))) {
+    fprintf(stderr, "Probleme de chargement de textures %s\n", buf);
+    fprintf(stderr, "\tNouvel essai avec %s\n", m->texture);
+    if (!(t = IMG_Load_RW(packRW(m->texture), 1))) {
+      fprintf(stderr, "Probleme de chargement de textures %s\n", m->texture);
+      return NULL;
     }
   }
-  for (n = 0; n < nd->mNumChildren; ++n) {
-    get_bounding_box_for_node(nd->mChildren[n], min, max, trafo);
+  return t;
+}
+
+static void meshCenter(mesh_t *m) {
+  GLfloat min[3] = {1e10f, 1e10f, 1e10f}, max[3] = {-1e10f, -1e10f, -1e10f};
+  int i, j;
+  if (!m->vertices || !m->nbVertices) {
+    m->center[0] = m->center[1] = m->center[2] = m->radius = 0.0f;
+    return;
+  }
+  for (i = 0; i < m->nbVertices; ++i)
+    for (j = 0; j < 3; ++j) {
+      min[j] = aisgl_min(min[j], m->vertices[3 * i + j]);
+      max[j] = aisgl_max(max[j], m->vertices[3 * i + j]);
+    }
+  for (j = 0; j < 3; ++j)
+    m->center[j] = (min[j] + max[j]) / 2.0f;
+  m->radius = sqrtf((max[0] - min[0]) * (max[0] - min[0]) +
+                    (max[1] - min[1]) * (max[1] - min[1]) +
+                    (max[2] - min[2]) * (max[2] - min[2])) /
+              2.0f;
+}
+
+static void freeMeshData(void) {
+  int i;
+  for (i = 0; i < _nbMeshes; ++i) {
+    free(_meshes[i].vertices);
+    _meshes[i].vertices = NULL;
+    free(_meshes[i].indices);
+    _meshes[i].indices = NULL;
   }
-  *trafo = prev;
 }
 
 static void get_bounding_box(struct aiVector3D *min, struct aiVector3D *max) {
@@ -203,7 +384,7 @@ static void get_bounding_box(struct aiVector3D *min, struct aiVector3D *max) {
   aiIdentityMatrix4(&trafo);
   min->x = min->y = min->z = 1e10f;
   max->x = max->y = max->z = -1e10f;
-  get_bounding_box_for_node(_scene->mRootNode, min, max, &trafo);
+  kernelBoundingBox(_scene, _scene->mRootNode, min, max, &trafo);
 }
 
 static void color4_to_float4(const struct aiColor4D *c, float f[4]) {
@@ -220,41 +401,35 @@ static void set_float4(float f[4], float a, float b, float c, float d) {
   f[3] = d;
 }
 
-static void apply_material(const struct aiMaterial *mtl) {
-  float c[4];
+static void get_material(const struct aiMaterial *mtl, material_t *m) {
   unsigned int max;
   float shininess, strength;
   struct aiColor4D diffuse, specular, ambient, emission;
-  GLint id;
-  glGetIntegerv(GL_CURRENT_PROGRAM, &id);
+  struct aiString tfname;
 
-  set_float4(c, 0.8f, 0.8f, 0.8f, 1.0f);
+  set_float4(m->diffuse, 0.8f, 0.8f, 0.8f, 1.0f);
   if (AI_SUCCESS ==
       aiGetMaterialColor(mtl, AI_MATKEY_COLOR_DIFFUSE, &diffuse)) {
-    color4_to_float4(&diffuse, c);
+    color4_to_float4(&diffuse, m->diffuse);
   }
-  glUniform4fv(glGetUniformLocation(id, "diffuse_color"), 1, c);
 
-  set_float4(c, 0.0f, 0.0f, 0.0f, 1.0f);
+  set_float4(m->specular, 0.0f, 0.0f, 0.0f, 1.0f);
   if (AI_SUCCESS ==
       aiGetMaterialColor(mtl, AI_MATKEY_COLOR_SPECULAR, &specular)) {
-    color4_to_float4(&specular, c);
+    color4_to_float4(&specular, m->specular);
   }
-  glUniform4fv(glGetUniformLocation(id, "specular_color"), 1, c);
 
-  set_float4(c, 0.2f, 0.2f, 0.2f, 1.0f);
+  set_float4(m->ambient, 0.2f, 0.2f, 0.2f, 1.0f);
   if (AI_SUCCESS ==
       aiGetMaterialColor(mtl, AI_MATKEY_COLOR_AMBIENT, &ambient)) {
-    color4_to_float4(&ambient, c);
+    color4_to_float4(&ambient, m->ambient);
   }
-  glUniform4fv(glGetUniformLocation(id, "ambient_color"), 1, c);
 
-  set_float4(c, 0.0f, 0.0f, 0.0f, 1.0f);
+  set_float4(m->emission, 0.0f, 0.0f, 0.0f, 1.0f);
   if (AI_SUCCESS ==
       aiGetMaterialColor(mtl, AI_MATKEY_COLOR_EMISSIVE, &emission)) {
-    color4_to_float4(&emission, c);
+    color4_to_float4(&emission, m->emission);
   }
-  glUniform4fv(glGetUniformLocation(id, "emission_color"), 1, c);
 
   max = 1;
   if (aiGetMaterialFloatArray(mtl, AI_MATKEY_SHININESS, &shininess, &max) ==
@@ -262,136 +437,290 @@ static void apply_material(const struct aiMaterial *mtl) {
     max = 1;
     if (aiGetMaterialFloatArray(mtl, AI_MATKEY_SHININESS_STRENGTH, &strength,
                                 &max) == AI_SUCCESS)
-      glUniform1f(glGetUniformLocation(id, "shininess"), shininess * strength);
+      m->shininess = shininess * strength;
     else
-      glUniform1f(glGetUniformLocation(id, "shininess"), shininess);
-  } else {
-    shininess = 0.0;
-    glUniform1f(glGetUniformLocation(id, "shininess"), shininess);
+      m->shininess = shininess;
+  } else
+    m->shininess = 0.0f;
+
+  max = 1;
+  if (aiGetMaterialFloatArray(mtl, AI_MATKEY_OPACITY, &m->opacity, &max) !=
+      AI_SUCCESS)
+    m->opacity = 1.0f;
+
+  m->texture[0] = '\0';
+  if (aiGetMaterialTextureCount(mtl, aiTextureType_DIFFUSE) > 0 &&
+      aiGetMaterialTexture(mtl, aiTextureType_DIFFUSE, 0, &tfname, NULL, NULL,
+                           NULL, NULL, NULL, NULL) == AI_SUCCESS)
+    snprintf(m->texture, sizeof m->texture, "%s", tfname.data);
+}
+
+static void apply_material(const material_t *m) {
+  GLint id;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &id);
+  glUniform4fv(glGetUniformLocation(id, "diffuse_color"), 1, m->diffuse);
+  glUniform4fv(glGetUniformLocation(id, "specular_color"), 1, m->specular);
+  glUniform4fv(glGetUniformLocation(id, "ambient_color"), 1, m->ambient);
+  glUniform4fv(glGetUniformLocation(id, "emission_color"), 1, m->emission);
+  glUniform1f(glGetUniformLocation(id, "shininess"), m->shininess);
+  glUniform1f(glGetUniformLocation(id, "opacity"), m->opacity);
+  glUniform1f(glGetUniformLocation(id, "alphaTest"),
+              m->alphaMode == MATERIAL_ALPHA_TEST ? ALPHA_TEST : 0.0f);
+}
+
+/* opaque si opacité pleine et canal alpha absent ou plein, test alpha si
+ * le canal alpha est (presque) binaire, translucide sinon */
+static void classifyMaterial(material_t *m, SDL_Surface *t) {
+  long x, y, partial = 0, transparent = 0;
+  m->alphaMode = MATERIAL_OPAQUE;
+  if (m->opacity < 1.0f) {
+    m->alphaMode = MATERIAL_TRANSLUCENT;
+    return;
+  }
+  /* seules les textures 32 bits sont envoyées avec leur canal alpha */
+  if (!t || !t->format->Amask || t->format->BytesPerPixel != 4)
+    return;
+  SDL_LockSurface(t);
+  for (y = 0; y < t->h; ++y) {
+    const Uint32 *row =
+        (const Uint32 *)((const Uint8 *)t->pixels + y * t->pitch);
+    for (x = 0; x < t->w; ++x) {
+      Uint32 a = (row[x] & t->format->Amask) >> t->format->Ashift;
+      if (a <= ALPHA_LOW)
+        transparent++;
+      else if (a < ALPHA_HIGH)
+        partial++;
+    }
+  }
+  SDL_UnlockSurface(t);
+  if (partial > ALPHA_PARTIAL_MAX * t->w * t->h)
+    m->alphaMode = MATERIAL_TRANSLUCENT;
+  else if (partial || transparent)
+    m->alphaMode = MATERIAL_ALPHA_TEST;
+}
+
+/* copie un maillage Assimp dans la disposition des VBO */
+static void meshPack(const struct aiMesh *mesh, mesh_t *m) {
+  int comp = kernelPackSize(mesh);
+  m->vertices = NULL;
+  m->indices = NULL;
+  m->count = 0;
+  m->nbVertices = mesh->mNumVertices;
+  m->material = mesh->mMaterialIndex;
+  m->hasNormals = mesh->mNormals != NULL;
+  m->hasTexCoords = mesh->mTextureCoords[0] != NULL;
+  if (!comp || !mesh->mVertices)
+    return;
+  m->vertices = malloc(comp * mesh->mNumVertices * sizeof *m->vertices);
+  assert(m->vertices);
+  kernelPackVertices(mesh, m->vertices);
+  if (mesh->mFaces) {
+    m->indices = malloc(3 * mesh->mNumFaces * sizeof *m->indices);
+    assert(m->indices);
+    m->count = kernelPackIndices(mesh, m->indices);
   }
 }
 
-static void sceneMkVAOs(const struct aiScene *sc, const struct aiNode *nd,
-                        GLuint *ivao) {
-  int i, j, comp;
+/* aplatit la hiérarchie de nœuds : chaque maillage garde la matrice
+ * cumulée de son nœud */
+static void sceneCollect(const struct aiScene *sc, const struct aiNode *nd,
+                         struct aiMatrix4x4 *trafo) {
+  struct aiMatrix4x4 prev;
   unsigned int n = 0;
-  static int temp = 0;
+  prev = *trafo;
+  /* By VB Inutile de transposer la matrice, gl4dummies fonctionne avec des
+   * transpose de GL. */
+  aiMultiplyMatrix4(trafo, &nd->mTransformation);
+  for (; n < nd->mNumMeshes; ++n) {
+    mesh_t *m = &_meshes[_nbMeshes++];
+    meshPack(sc->mMeshes[nd->mMeshes[n]], m);
+    memcpy(m->transform, trafo, sizeof m->transform);
+  }
+  for (n = 0; n < nd->mNumChildren; ++n)
+    sceneCollect(sc, nd->mChildren[n], trafo);
+  *trafo = prev;
+}
 
-  temp++;
+static void sceneMkVAOs(void) {
+  int i, k;
 
-  for (; n < nd->mNumMeshes; ++n) {
-    GLfloat *vertices = NULL;
-    GLuint *indices = NULL;
-    const struct aiMesh *mesh = sc->mMeshes[nd->mMeshes[n]];
-    comp = mesh->mVertices ? 3 : 0;
-    comp += mesh->mNormals ? 3 : 0;
-    comp += mesh->mTextureCoords[0] ? 2 : 0;
-    if (!comp)
+  for (k = 0; k < _nbMeshes; ++k) {
+    const mesh_t *m = &_meshes[k];
+    if (!m->vertices)
       continue;
 
-    glBindVertexArray(_vaos[*ivao]);
-    glBindBuffer(GL_ARRAY_BUFFER, _buffers[2 * (*ivao)]);
-
-    vertices = malloc(comp * mesh->mNumVertices * sizeof *vertices);
-    assert(vertices);
+    glBindVertexArray(_vaos[k]);
+    glBindBuffer(GL_ARRAY_BUFFER, _buffers[2 * k]);
     i = 0;
     glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
     glDisableVertexAttribArray(2);
-    if (mesh->mVertices) {
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0,
-                            (const void *)(i * sizeof *vertices));
-      for (j = 0; j < mesh->mNumVertices; ++j) {
-        vertices[i++] = mesh->mVertices[j].x;
-        vertices[i++] = mesh->mVertices[j].y;
-        vertices[i++] = mesh->mVertices[j].z;
-      }
-    }
-    if (mesh->mNormals) {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0,
+                          (const void *)(i * sizeof *m->vertices));
+    i += 3 * m->nbVertices;
+    if (m->hasNormals) {
       glEnableVertexAttribArray(1);
       glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0,
-                            (const void *)(i * sizeof *vertices));
-      for (j = 0; j < mesh->mNumVertices; ++j) {
-        vertices[i++] = mesh->mNormals[j].x;
-        vertices[i++] = mesh->mNormals[j].y;
-        vertices[i++] = mesh->mNormals[j].z;
-      }
+                            (const void *)(i * sizeof *m->vertices));
+      i += 3 * m->nbVertices;
     }
-    if (mesh->mTextureCoords[0]) {
+    if (m->hasTexCoords) {
       glEnableVertexAttribArray(2);
       glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0,
-                            (const void *)(i * sizeof *vertices));
-      for (j = 0; j < mesh->mNumVertices; ++j) {
-        vertices[i++] = mesh->mTextureCoords[0][j].x;
-        vertices[i++] = mesh->mTextureCoords[0][j].y;
-      }
+                            (const void *)(i * sizeof *m->vertices));
+      i += 2 * m->nbVertices;
     }
-    glBufferData(GL_ARRAY_BUFFER, (i * sizeof *vertices), vertices,
+    glBufferData(GL_ARRAY_BUFFER, (i * sizeof *m->vertices), m->vertices,
                  GL_STATIC_DRAW);
-    free(vertices);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffers[2 * (*ivao) + 1]);
-    if (mesh->mFaces) {
-      indices = malloc(3 * mesh->mNumFaces * sizeof *indices);
-      assert(indices);
-      for (i = 0, j = 0; j < mesh->mNumFaces; ++j) {
-        assert(mesh->mFaces[j].mNumIndices < 4);
-        if (mesh->mFaces[j].mNumIndices != 3)
-          continue;
-        indices[i++] = mesh->mFaces[j].mIndices[0];
-        indices[i++] = mesh->mFaces[j].mIndices[1];
-        indices[i++] = mesh->mFaces[j].mIndices[2];
-      }
-      glBufferData(GL_ELEMENT_ARRAY_BUFFER, i * sizeof *indices, indices,
-                   GL_STATIC_DRAW);
-      _counts[*ivao] = i;
-      free(indices);
-    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffers[2 * k + 1]);
+    if (m->indices)
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, m->count * sizeof *m->indices,
+                   m->indices, GL_STATIC_DRAW);
     glBindVertexArray(0);
-    (*ivao)++;
   }
-  for (n = 0; n < nd->mNumChildren; ++n) {
-    sceneMkVAOs(sc, nd->mChildren[n], ivao);
+}
+
+/* range les opaques au début de _order et les translucides à la fin, puis
+ * trie les premiers d'avant en arrière et les seconds d'arrière en avant */
+static void scenePrepare(int slot, const GLfloat *proj, const GLfloat *mv,
+                         uboFrame *f, unsigned int base) {
+  int k, p, visible;
+  GLfloat mvk[16], planes[6][4], c[3], r, s;
+  drawItem_t *order = _order[slot];
+  int nbOpaque = 0, nbTranslucent = 0;
+  frustumPlanes(proj, planes);
+  for (k = 0; k < _nbMeshes; ++k) {
+    const mesh_t *m = &_meshes[k];
+    drawItem_t *it;
+    if (!m->count)
+      continue;
+    mat4Multiply(mvk, mv, m->transform);
+    /* sphère dans le repère vue, rayon agrandi par la plus forte échelle */
+    for (p = 0; p < 3; ++p)
+      c[p] = mvk[4 * p] * m->center[0] + mvk[4 * p + 1] * m->center[1] +
+             mvk[4 * p + 2] * m->center[2] + mvk[4 * p + 3];
+    for (p = 0, s = 0.0f; p < 3; ++p)
+      s = aisgl_max(s, mvk[p] * mvk[p] + mvk[4 + p] * mvk[4 + p] +
+                           mvk[8 + p] * mvk[8 + p]);
+    r = m->radius * sqrtf(s);
+    for (p = 0, visible = 1; visible && p < 6; ++p)
+      visible = planes[p][0] * c[0] + planes[p][1] * c[1] +
+                    planes[p][2] * c[2] + planes[p][3] >=
+                -r;
+    if (!visible)
+      continue;
+    if (_materials[m->material].alphaMode == MATERIAL_TRANSLUCENT)
+      it = &order[_nbMeshes - ++nbTranslucent];
+    else
+      it = &order[nbOpaque++];
+    it->mesh = k;
+    it->depth = c[2];
+    it->object = base + k;
+    uboSet(f, it->object, mvk);
   }
+  qsort(order, nbOpaque, sizeof *order, frontToBack);
+  qsort(order + _nbMeshes - nbTranslucent, nbTranslucent, sizeof *order,
+        backToFront);
+  _nbOpaque[slot] = nbOpaque;
+  _nbTranslucent[slot] = nbTranslucent;
 }
 
-static void sceneDrawVAOs(const struct aiScene *sc, const struct aiNode *nd,
-                          GLuint *ivao) {
-  unsigned int n = 0;
-  struct aiMatrix4x4 m = nd->mTransformation;
+/* plans du volume de vue dans le repère vue (Gribb et Hartmann), normés,
+ * l'intérieur du côté positif */
+static void frustumPlanes(const GLfloat *proj, GLfloat planes[6][4]) {
+  int i, j;
+  for (i = 0; i < 3; ++i)
+    for (j = 0; j < 4; ++j) {
+      planes[2 * i][j] = proj[12 + j] + proj[4 * i + j];
+      planes[2 * i + 1][j] = proj[12 + j] - proj[4 * i + j];
+    }
+  for (i = 0; i < 6; ++i) {
+    GLfloat n = sqrtf(planes[i][0] * planes[i][0] +
+                      planes[i][1] * planes[i][1] +
+                      planes[i][2] * planes[i][2]);
+    for (j = 0; n > 0.0f && j < 4; ++j)
+      planes[i][j] /= n;
+  }
+}
+
+/* opaques d'avant en arrière, sans mélange et après une éventuelle passe
+ * de profondeur seule, puis translucides d'arrière en avant avec mélange */
+static void sceneDrawVAOs(int slot) {
+  int k, nbOpaque = _nbOpaque[slot], nbTranslucent = _nbTranslucent[slot];
+  const drawItem_t *order = _order[slot];
   GLint id;
 
   glGetIntegerv(GL_CURRENT_PROGRAM, &id);
-  /* By VB Inutile de transposer la matrice, gl4dummies fonctionne avec des
-   * transpose de GL. */
-  /* aiTransposeMatrix4(&m); */
-  gl4duPushMatrix();
-  gl4duMultMatrixf((GLfloat *)&m);
-  gl4duSendMatrices();
+  glDisable(GL_BLEND);
+  if (_depthPrepass && nbOpaque) {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    for (k = 0; k < nbOpaque; ++k)
+      sceneDrawMesh(id, &order[k]);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    /* la profondeur est déjà la bonne : seul le fragment visible est coloré */
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+  }
+  for (k = 0; k < nbOpaque; ++k)
+    sceneDrawMesh(id, &order[k]);
+  glDepthFunc(GL_LESS);
+
+  glDepthMask(GL_FALSE);
+  glEnable(GL_BLEND);
+  for (k = _nbMeshes - nbTranslucent; k < _nbMeshes; ++k)
+    sceneDrawMesh(id, &order[k]);
+  glDisable(GL_BLEND);
+  glDepthMask(GL_TRUE);
+}
 
-  for (; n < nd->mNumMeshes; ++n) {
-    const struct aiMesh *mesh = sc->mMeshes[nd->mMeshes[n]];
-    if (_counts[*ivao]) {
-      glBindVertexArray(_vaos[*ivao]);
-      apply_material(sc->mMaterials[mesh->mMaterialIndex]);
-      if (aiGetMaterialTextureCount(sc->mMaterials[mesh->mMaterialIndex],
-                                    aiTextureType_DIFFUSE) > 0) {
-        glBindTexture(GL_TEXTURE_2D, _textures[mesh->mMaterialIndex]);
-        glUniform1i(glGetUniformLocation(id, "hasTexture"), 1);
-        glUniform1i(glGetUniformLocation(id, "myTexture"), 0);
-      } else {
-        glUniform1i(glGetUniformLocation(id, "hasTexture"), 0);
-      }
-      glDrawElements(GL_TRIANGLES, _counts[*ivao], GL_UNSIGNED_INT, 0);
-      glBindVertexArray(0);
-      glBindTexture(GL_TEXTURE_2D, 0);
-    }
-    (*ivao)++;
+static void sceneDrawMesh(GLint id, const drawItem_t *it) {
+  const mesh_t *m = &_meshes[it->mesh];
+  const material_t *mt = &_materials[m->material];
+  uboBind(it->object);
+  glBindVertexArray(_vaos[it->mesh]);
+  apply_material(mt);
+  if (mt->texture[0]) {
+    glBindTexture(GL_TEXTURE_2D, _textures[m->material]);
+    glUniform1i(glGetUniformLocation(id, "hasTexture"), 1);
+    glUniform1i(glGetUniformLocation(id, "myTexture"), 0);
+  } else {
+    glUniform1i(glGetUniformLocation(id, "hasTexture"), 0);
   }
-  for (n = 0; n < nd->mNumChildren; ++n) {
-    sceneDrawVAOs(sc, nd->mChildren[n], ivao);
+  glDrawElements(GL_TRIANGLES, m->count, GL_UNSIGNED_INT, 0);
+  glBindVertexArray(0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/* la caméra regarde vers -z : le plus proche a le plus grand z */
+static int frontToBack(const void *a, const void *b) {
+  GLfloat za = ((const drawItem_t *)a)->depth,
+          zb = ((const drawItem_t *)b)->depth;
+  return (za < zb) - (za > zb);
+}
+
+static int backToFront(const void *a, const void *b) {
+  return frontToBack(b, a);
+}
+
+static void sceneRasterVAOs(void) {
+  int k;
+  for (k = 0; k < _nbMeshes; ++k) {
+    const mesh_t *m = &_meshes[k];
+    const rasterTexture *t = &_rtextures[m->material];
+    if (!m->count)
+      continue;
+    rasterPushMatrix();
+    rasterMultMatrix(m->transform);
+    rasterBindTexture(t->texels ? t : NULL);
+    rasterDrawElements(m->vertices,
+                       m->hasTexCoords
+                           ? m->vertices + (m->hasNormals ? 6 : 3) *
+                                               m->nbVertices
+                           : NULL,
+                       m->nbVertices, m->indices, m->count);
+    rasterPopMatrix();
   }
-  gl4duPopMatrix();
 }
 
 static int sceneNbMeshes(const struct aiScene *sc, const struct aiNode *nd,
@@ -403,22 +732,165 @@ static int sceneNbMeshes(const struct aiScene *sc, const struct aiNode *nd,
   return subtotal;
 }
 
+/* chargeur rapide pour les .obj : remplit directement maillages et
+ * matériaux, renvoie 1 pour laisser Assimp s'en charger en cas d'échec */
+static int loadobj(const char *path) {
+  int i;
+  objScene *s;
+  if (!(s = objLoad(path, 0)))
+    return 1;
+  _nbMeshes = s->nbMeshes;
+  _meshes = calloc(_nbMeshes, sizeof *_meshes);
+  assert(_meshes);
+  for (i = 0; i < _nbMeshes; ++i) {
+    mesh_t *m = &_meshes[i];
+    objMesh *om = &s->meshes[i];
+    /* les tampons sont repris tels quels */
+    m->vertices = om->vertices;
+    m->indices = om->indices;
+    om->vertices = NULL;
+    om->indices = NULL;
+    m->nbVertices = om->nbVertices;
+    m->count = om->count;
+    m->material = om->material;
+    m->hasNormals = om->hasNormals;
+    m->hasTexCoords = om->hasTexCoords;
+    set_float4(&m->transform[0], 1.0f, 0.0f, 0.0f, 0.0f);
+    set_float4(&m->transform[4], 0.0f, 1.0f, 0.0f, 0.0f);
+    set_float4(&m->transform[8], 0.0f, 0.0f, 1.0f, 0.0f);
+    set_float4(&m->transform[12], 0.0f, 0.0f, 0.0f, 1.0f);
+  }
+  _nbTextures = s->nbMaterials;
+  _materials = calloc(_nbTextures, sizeof *_materials);
+  assert(_materials);
+  for (i = 0; i < _nbTextures; ++i) {
+    const objMaterial *om = &s->materials[i];
+    material_t *m = &_materials[i];
+    memcpy(m->diffuse, om->diffuse, sizeof m->diffuse);
+    memcpy(m->specular, om->specular, sizeof m->specular);
+    memcpy(m->ambient, om->ambient, sizeof m->ambient);
+    memcpy(m->emission, om->emission, sizeof m->emission);
+    m->shininess = om->shininess;
+    m->opacity = om->opacity;
+    snprintf(m->texture, sizeof m->texture, "%s", om->texture);
+  }
+  _scene_min.x = s->min[0];
+  _scene_min.y = s->min[1];
+  _scene_min.z = s->min[2];
+  _scene_max.x = s->max[0];
+  _scene_max.y = s->max[1];
+  _scene_max.z = s->max[2];
+  objFree(s);
+  return 0;
+}
+
 static int loadasset(const char *path) {
+  const char *ext = strrchr(path, '.');
+  struct aiMatrix4x4 trafo;
+  struct aiFileIO io = {memOpen, memClose, NULL};
+  size_t size;
+  int i;
+  if (ext && !strcasecmp(ext, ".obj") && loadobj(path) == 0) {
+    _scene_center.x = (_scene_min.x + _scene_max.x) / 2.0f;
+    _scene_center.y = (_scene_min.y + _scene_max.y) / 2.0f;
+    _scene_center.z = (_scene_min.z + _scene_max.z) / 2.0f;
+    return 0;
+  }
   /* we are taking one of the postprocessing presets to avoid
      spelling out 20+ single postprocessing flags here. */
   /* struct aiString str; */
   /* aiGetExtensionList(&str); */
   /* fprintf(stderr, "EXT %s\n", str.data); */
-  _scene = aiImportFile(
-      path, aiProcessPreset_TargetRealtime_MaxQuality |
-                aiProcess_CalcTangentSpace | aiProcess_Triangulate |
-                aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
+  /* le modèle et ses fichiers annexes sont lus dans l'archive s'il y est */
+  if (packData(path, &size))
+    _scene = aiImportFileEx(path, KERNEL_AI_FLAGS, &io);
+  else
+    _scene = aiImportFile(path, KERNEL_AI_FLAGS);
   if (_scene) {
     get_bounding_box(&_scene_min, &_scene_max);
     _scene_center.x = (_scene_min.x + _scene_max.x) / 2.0f;
     _scene_center.y = (_scene_min.y + _scene_max.y) / 2.0f;
     _scene_center.z = (_scene_min.z + _scene_max.z) / 2.0f;
+    _meshes = calloc(sceneNbMeshes(_scene, _scene->mRootNode, 0),
+                     sizeof *_meshes);
+    assert(_meshes);
+    _nbMeshes = 0;
+    aiIdentityMatrix4(&trafo);
+    sceneCollect(_scene, _scene->mRootNode, &trafo);
+    _nbTextures = _scene->mNumMaterials;
+    _materials = calloc(_nbTextures, sizeof *_materials);
+    assert(_materials);
+    for (i = 0; i < _nbTextures; ++i)
+      get_material(_scene->mMaterials[i], &_materials[i]);
+    /* cleanup - calling 'aiReleaseImport' is important, as the library
+       keeps internal resources until the scene is freed again. Not
+       doing so can cause severe resource leaking. */
+    aiReleaseImport(_scene);
+    _scene = NULL;
     return 0;
   }
   return 1;
 }
+
+/* les fichiers absents de l'archive sont vus comme inexistants */
+static struct aiFile *memOpen(struct aiFileIO *io, const char *name,
+                              const char *mode) {
+  memFile_t *mf;
+  const char *data;
+  size_t size;
+  (void)io;
+  if (strchr(mode, 'w') || !(data = packData(name, &size)))
+    return NULL;
+  mf = calloc(1, sizeof *mf);
+  assert(mf);
+  mf->file.ReadProc = memRead;
+  mf->file.WriteProc = memWrite;
+  mf->file.TellProc = memTell;
+  mf->file.FileSizeProc = memSize;
+  mf->file.SeekProc = memSeek;
+  mf->file.FlushProc = memFlush;
+  mf->data = data;
+  mf->size = size;
+  return &mf->file;
+}
+
+static void memClose(struct aiFileIO *io, struct aiFile *f) {
+  (void)io;
+  free(f);
+}
+
+static size_t memRead(struct aiFile *f, char *buf, size_t size, size_t count) {
+  memFile_t *mf = (memFile_t *)f;
+  size_t n = size ? (mf->size - mf->pos) / size : 0;
+  n = n < count ? n : count;
+  memcpy(buf, mf->data + mf->pos, n * size);
+  mf->pos += n * size;
+  return n;
+}
+
+static size_t memWrite(struct aiFile *f, const char *buf, size_t size,
+                       size_t count) {
+  (void)f;
+  (void)buf;
+  (void)size;
+  (void)count;
+  return 0;
+}
+
+static size_t memTell(struct aiFile *f) { return ((memFile_t *)f)->pos; }
+
+static size_t memSize(struct aiFile *f) { return ((memFile_t *)f)->size; }
+
+static enum aiReturn memSeek(struct aiFile *f, size_t offset,
+                             enum aiOrigin origin) {
+  memFile_t *mf = (memFile_t *)f;
+  size_t base = origin == aiOrigin_SET ? 0
+                : origin == aiOrigin_CUR ? mf->pos
+                                         : mf->size;
+  if (offset > mf->size - base)
+    return aiReturn_FAILURE;
+  mf->pos = base + offset;
+  return aiReturn_SUCCESS;
+}
+
+static void memFlush(struct aiFile *f) { (void)f; }
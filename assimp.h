@@ -9,12 +9,20 @@
 
 #define _ASSIMP_H
 
+#include "ubo.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
   extern void assimpInit(const char * filename);
-  extern void assimpDrawScene(void);
+  extern void assimpInitRaster(const char * filename);
+  extern unsigned int assimpNbMeshes(void);
+  extern void assimpPrepareScene(int slot, const float *proj,
+                                 const float *mv, uboFrame *f,
+                                 unsigned int base);
+  extern void assimpDrawScene(int slot);
+  extern void assimpRasterScene(void);
   extern void assimpQuit(void);
   
 #ifdef __cplusplus
@@ -0,0 +1,219 @@
+/*!\file bench.c
+ *
+ * \brief mesures des noyaux de kernels.c, sans fenêtre ni contexte
+ * OpenGL : analyse du spectre sur des blocs audio synthétiques,
+ * réductions par bandes, boîte englobante et rangement des sommets du
+ * modèle livré.
+ *
+ * Chaque noyau est d'abord chauffé, le nombre d'itérations par
+ * échantillon est calibré pour durer au moins BENCH_SAMPLE_NS, puis
+ * BENCH_SAMPLES échantillons sont mesurés ; la médiane, le minimum et
+ * l'écart type sont donnés en ns par opération.
+ *
+ * Usage : ALYS_squares_bench [modèle] (par défaut
+ * models/ALYS_ShapeChange.obj).
+ *
+ * \author Lucien Cartier
+ */
+
+#include "kernels.h"
+#include <assert.h>
+#include <assimp/cimport.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ECHANTILLONS 1024 /* taille d'un bloc, comme dans window.c */
+#define LIMIT_BASS 10
+#define LIMIT_HIGH 500
+#define NB_BLOCKS 64 /* blocs audio synthétiques parcourus en boucle */
+#define BENCH_WARMUP_NS 100000000.0 /* 100 ms */
+#define BENCH_SAMPLE_NS 10000000.0  /* 10 ms */
+#define BENCH_SAMPLES 31
+
+typedef void (*benchFunc)(void *arg);
+
+static double now(void);
+static int cmpDouble(const void *a, const void *b);
+static void benchRun(const char *name, benchFunc f, void *arg, double items,
+                     const char *unit);
+static void genAudio(short *samples, int n);
+static void bSpectrum(void *arg);
+static void bBands(void *arg);
+static void bBoundingBox(void *arg);
+static void bPack(void *arg);
+
+/* données d'entrée des noyaux ***********************************************/
+static short _blocks[NB_BLOCKS][ECHANTILLONS], _hauteurs[ECHANTILLONS];
+static int _block = 0;
+static fftw_complex *_in = NULL, *_out = NULL;
+static fftw_plan _plan = NULL;
+static const struct aiScene *_scene = NULL;
+static float *_vertices = NULL;
+static unsigned int *_indices = NULL;
+/* empêche le compilateur d'éliminer les résultats */
+static volatile float _sink;
+
+int main(int argc, char **argv) {
+  const char *filename = argc > 1 ? argv[1] : "models/ALYS_ShapeChange.obj";
+  unsigned int i, nbVertices = 0, nbFaces = 0, maxVertices = 0,
+                  maxFaces = 0;
+  int b;
+  double bytes = 0.0;
+
+  /* audio : FFT préparée exactement comme dans initAudio */
+  for (b = 0; b < NB_BLOCKS; ++b)
+    genAudio(_blocks[b], ECHANTILLONS);
+  _in = fftw_malloc(ECHANTILLONS * sizeof *_in);
+  assert(_in);
+  memset(_in, 0, ECHANTILLONS * sizeof *_in);
+  _out = fftw_malloc(ECHANTILLONS * sizeof *_out);
+  assert(_out);
+  _plan = fftw_plan_dft_1d(ECHANTILLONS, _in, _out, FFTW_FORWARD,
+                           FFTW_ESTIMATE);
+  assert(_plan);
+
+  printf("%-28s %12s %12s %8s %16s\n", "noyau", "ns/op (med)", "ns/op (min)",
+         "ecart", "debit");
+  benchRun("spectre (fft + amplitudes)", bSpectrum, NULL, ECHANTILLONS,
+           "ech/s");
+  benchRun("bandes (volume/basses/aigus)", bBands, NULL,
+           2 * ECHANTILLONS - LIMIT_HIGH + LIMIT_BASS, "ech/s");
+
+  /* scène : importée avec les mêmes options que loadasset */
+  if (!(_scene = aiImportFile(filename, KERNEL_AI_FLAGS))) {
+    fprintf(stderr, "Erreur lors du chargement du fichier %s\n", filename);
+    exit(3);
+  }
+  for (i = 0; i < _scene->mNumMeshes; ++i) {
+    const struct aiMesh *mesh = _scene->mMeshes[i];
+    unsigned int size = kernelPackSize(mesh) * mesh->mNumVertices;
+    nbVertices += mesh->mNumVertices;
+    nbFaces += mesh->mNumFaces;
+    bytes += size * sizeof *_vertices + 3 * mesh->mNumFaces * sizeof *_indices;
+    maxVertices = size > maxVertices ? size : maxVertices;
+    maxFaces = mesh->mNumFaces > maxFaces ? mesh->mNumFaces : maxFaces;
+  }
+  _vertices = malloc((maxVertices ? maxVertices : 1) * sizeof *_vertices);
+  assert(_vertices);
+  _indices = malloc((maxFaces ? 3 * maxFaces : 1) * sizeof *_indices);
+  assert(_indices);
+  printf("# %s : %u maillages, %u sommets, %u faces\n", filename,
+         _scene->mNumMeshes, nbVertices, nbFaces);
+  benchRun("boite englobante", bBoundingBox, NULL, nbVertices, "sommets/s");
+  benchRun("rangement sommets/indices", bPack, NULL, nbVertices, "sommets/s");
+  printf("# rangement : %.2f Mo écrits par opération\n", bytes / 1.0e6);
+
+  aiReleaseImport(_scene);
+  free(_vertices);
+  free(_indices);
+  fftw_destroy_plan(_plan);
+  fftw_free(_in);
+  fftw_free(_out);
+  return 0;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1.0e9 + ts.tv_nsec;
+}
+
+static int cmpDouble(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* items : éléments traités par opération, pour le débit */
+static void benchRun(const char *name, benchFunc f, void *arg, double items,
+                     const char *unit) {
+  double samples[BENCH_SAMPLES], t0, t, mean = 0.0, var = 0.0;
+  long iters = 1, k;
+  int s;
+  /* chauffe et calibration : on double le nombre d'itérations jusqu'à ce
+   * qu'un échantillon dure assez longtemps pour être mesuré fiablement */
+  t0 = now();
+  for (;;) {
+    t = now();
+    for (k = 0; k < iters; ++k)
+      f(arg);
+    t = now() - t;
+    if (t >= BENCH_SAMPLE_NS && now() - t0 >= BENCH_WARMUP_NS)
+      break;
+    if (t < BENCH_SAMPLE_NS)
+      iters *= 2;
+  }
+  for (s = 0; s < BENCH_SAMPLES; ++s) {
+    t = now();
+    for (k = 0; k < iters; ++k)
+      f(arg);
+    samples[s] = (now() - t) / iters;
+    mean += samples[s];
+  }
+  mean /= BENCH_SAMPLES;
+  for (s = 0; s < BENCH_SAMPLES; ++s)
+    var += (samples[s] - mean) * (samples[s] - mean);
+  var /= BENCH_SAMPLES - 1;
+  qsort(samples, BENCH_SAMPLES, sizeof *samples, cmpDouble);
+  printf("%-28s %12.1f %12.1f %7.1f%% %10.3g %s\n", name,
+         samples[BENCH_SAMPLES / 2], samples[0], 100.0 * sqrt(var) / mean,
+         items * 1.0e9 / samples[BENCH_SAMPLES / 2], unit);
+}
+
+/* quelques sinusoïdes et un bruit pseudo-aléatoire fixe, pour des mesures
+ * reproductibles */
+static void genAudio(short *samples, int n) {
+  static unsigned int seed = 12345;
+  int i;
+  for (i = 0; i < n; ++i) {
+    double v = 0.4 * sin(2.0 * M_PI * 55.0 * i / 44100.0) +
+               0.2 * sin(2.0 * M_PI * 440.0 * i / 44100.0) +
+               0.1 * sin(2.0 * M_PI * 3520.0 * i / 44100.0);
+    seed = seed * 1103515245u + 12345u;
+    v += 0.1 * ((seed >> 16 & 0x7fff) / 16383.5 - 1.0);
+    samples[i] = (short)(v * 32767.0);
+  }
+}
+
+static void bSpectrum(void *arg) {
+  (void)arg;
+  kernelSpectrum(_blocks[_block], ECHANTILLONS, _plan, _in, _out, _hauteurs,
+                 NULL);
+  _block = (_block + 1) % NB_BLOCKS;
+}
+
+static void bBands(void *arg) {
+  float volume = 0, basses = 0, high = 0;
+  (void)arg;
+  volume = kernelBand(volume, _hauteurs, 0, ECHANTILLONS);
+  basses = kernelBand(basses, _hauteurs, 0, LIMIT_BASS);
+  high = kernelBand(high, _hauteurs, LIMIT_HIGH, ECHANTILLONS);
+  _sink = volume + basses + high;
+}
+
+static void bBoundingBox(void *arg) {
+  struct aiVector3D min, max;
+  struct aiMatrix4x4 trafo;
+  (void)arg;
+  aiIdentityMatrix4(&trafo);
+  min.x = min.y = min.z = 1e10f;
+  max.x = max.y = max.z = -1e10f;
+  kernelBoundingBox(_scene, _scene->mRootNode, &min, &max, &trafo);
+  _sink = min.x + max.x;
+}
+
+static void bPack(void *arg) {
+  unsigned int i;
+  (void)arg;
+  for (i = 0; i < _scene->mNumMeshes; ++i) {
+    const struct aiMesh *mesh = _scene->mMeshes[i];
+    if (!kernelPackSize(mesh) || !mesh->mVertices)
+      continue;
+    kernelPackVertices(mesh, _vertices);
+    if (mesh->mFaces)
+      kernelPackIndices(mesh, _indices);
+  }
+  _sink = _vertices[0];
+}
@@ -0,0 +1,182 @@
+/*!\file dynres.c
+ *
+ * \brief rendu à résolution dynamique.
+ *
+ * La cible hors écran est allouée une fois à l'échelle maximale ; chaque
+ * frame ne dessine que dans la sous-région correspondant à l'échelle
+ * courante, ce qui évite toute réallocation quand l'échelle change. Le
+ * coût d'une frame est le plus grand des temps GPU (requêtes
+ * GL_TIME_ELAPSED lues avec quelques frames de retard pour ne jamais
+ * bloquer) et CPU (soumission entre dynresBegin et dynresEnd).
+ *
+ * Variables d'environnement : SQUARES_TARGET_FPS (60), SQUARES_MIN_SCALE
+ * (0.5), SQUARES_MAX_SCALE (1.0) et SQUARES_SHARPNESS (0.2).
+ *
+ * \author Lucien Cartier
+ */
+
+#include "dynres.h"
+#include "pack.h"
+#include <GL4D/gl4dg.h>
+#include <GL4D/gl4du.h>
+#include <GL4D/gl4duw_SDL2.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NB_QUERIES 4
+
+static float envFloat(const char *name, float def, float min, float max);
+
+static GLuint _fbo = 0, _colorTex = 0, _depthRb = 0, _pId = 0, _quad = 0;
+static GLuint _queries[NB_QUERIES];
+static int _queryHead = 0, _queryPending = 0, _queryActive = 0;
+static int _wW = 0, _wH = 0, _fW = 0, _fH = 0, _sW = 0, _sH = 0;
+static float _targetFps = 60.0f, _minScale = 0.5f, _maxScale = 1.0f,
+             _sharpness = 0.2f, _scale = 1.0f;
+static double _cost = -1.0, _gpu = 0.0; /* en ms, coût lissé et GPU */
+static Uint64 _t0 = 0;
+
+void dynresInit(int w, int h) {
+  char *vs = packShader("vs", "shaders/upscale.vs"),
+       *fs = packShader("fs", "shaders/upscale.fs");
+  _targetFps = envFloat("SQUARES_TARGET_FPS", 60.0f, 1.0f, 1000.0f);
+  _minScale = envFloat("SQUARES_MIN_SCALE", 0.5f, 0.1f, 1.0f);
+  _maxScale = envFloat("SQUARES_MAX_SCALE", 1.0f, _minScale, 2.0f);
+  _sharpness = envFloat("SQUARES_SHARPNESS", 0.2f, 0.0f, 1.0f);
+  _scale = _maxScale;
+  _pId = gl4duCreateProgram(vs, fs, NULL);
+  free(vs);
+  free(fs);
+  _quad = gl4dgGenQuadf();
+  glGenFramebuffers(1, &_fbo);
+  glGenTextures(1, &_colorTex);
+  glGenRenderbuffers(1, &_depthRb);
+  glGenQueries(NB_QUERIES, _queries);
+  dynresResize(w, h);
+}
+
+void dynresResize(int w, int h) {
+  _wW = w;
+  _wH = h;
+  _fW = (int)ceilf(w * _maxScale);
+  _fH = (int)ceilf(h * _maxScale);
+  glBindTexture(GL_TEXTURE_2D, _colorTex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, _fW, _fH, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindRenderbuffer(GL_RENDERBUFFER, _depthRb);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _fW, _fH);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         _colorTex, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, _depthRb);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    fprintf(stderr, "dynres: framebuffer %dx%d incomplet\n", _fW, _fH);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* à appeler avant tout dessin de la scène */
+void dynresBegin(void) {
+  _sW = (int)(_wW * _scale + 0.5f);
+  _sH = (int)(_wH * _scale + 0.5f);
+  _sW = _sW < 1 ? 1 : (_sW > _fW ? _fW : _sW);
+  _sH = _sH < 1 ? 1 : (_sH > _fH ? _fH : _sH);
+  glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+  glViewport(0, 0, _sW, _sH);
+  if ((_queryActive = _queryPending < NB_QUERIES))
+    glBeginQuery(GL_TIME_ELAPSED, _queries[_queryHead]);
+  _t0 = SDL_GetPerformanceCounter();
+}
+
+/* agrandit la sous-région vers la fenêtre et adapte l'échelle */
+void dynresEnd(void) {
+  double cpu, ms, budget = 1000.0 / _targetFps;
+  GLint available = 0;
+  int oldest;
+  GLuint64 ns;
+  cpu = (SDL_GetPerformanceCounter() - _t0) * 1000.0 /
+        SDL_GetPerformanceFrequency();
+  if (_queryActive) {
+    glEndQuery(GL_TIME_ELAPSED);
+    _queryHead = (_queryHead + 1) % NB_QUERIES;
+    _queryPending++;
+  }
+  /* la plus ancienne requête en vol, lue seulement si disponible */
+  if (_queryPending) {
+    oldest = (_queryHead - _queryPending + NB_QUERIES) % NB_QUERIES;
+    glGetQueryObjectiv(_queries[oldest], GL_QUERY_RESULT_AVAILABLE,
+                       &available);
+    if (available) {
+      glGetQueryObjectui64v(_queries[oldest], GL_QUERY_RESULT, &ns);
+      _gpu = ns / 1.0e6;
+      _queryPending--;
+    }
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, _wW, _wH);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  glDisable(GL_CULL_FACE);
+  glUseProgram(_pId);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, _colorTex);
+  glUniform1i(glGetUniformLocation(_pId, "tex"), 0);
+  glUniform2f(glGetUniformLocation(_pId, "texScale"), (GLfloat)_sW / _fW,
+              (GLfloat)_sH / _fH);
+  /* plus l'agrandissement est fort, plus la netteté est renforcée */
+  glUniform1f(glGetUniformLocation(_pId, "sharpness"),
+              _sharpness * (_wW > _sW ? (GLfloat)_wW / _sW : 1.0f));
+  gl4dgDraw(_quad);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glUseProgram(0);
+  glEnable(GL_CULL_FACE);
+  glEnable(GL_DEPTH_TEST);
+
+  ms = _gpu > cpu ? _gpu : cpu;
+  _cost = _cost < 0.0 ? ms : 0.9 * _cost + 0.1 * ms;
+  /* le coût est proportionnel au nombre de pixels, donc à scale² ; descente
+   * rapide, remontée lente et zone morte entre 80 et 100% du budget */
+  if (_cost > budget)
+    _scale *= fmax(0.9, sqrt(budget / _cost));
+  else if (_cost < 0.8 * budget)
+    _scale *= fmin(1.02, sqrt(0.9 * budget / _cost));
+  _scale = _scale < _minScale ? _minScale
+                              : (_scale > _maxScale ? _maxScale : _scale);
+}
+
+float dynresScale(void) { return _scale; }
+
+void dynresQuit(void) {
+  if (_fbo) {
+    glDeleteFramebuffers(1, &_fbo);
+    _fbo = 0;
+  }
+  if (_colorTex) {
+    glDeleteTextures(1, &_colorTex);
+    _colorTex = 0;
+  }
+  if (_depthRb) {
+    glDeleteRenderbuffers(1, &_depthRb);
+    _depthRb = 0;
+  }
+  if (_queries[0]) {
+    glDeleteQueries(NB_QUERIES, _queries);
+    _queries[0] = 0;
+  }
+}
+
+static float envFloat(const char *name, float def, float min, float max) {
+  const char *env = getenv(name);
+  float v = env ? (float)atof(env) : def;
+  if (!(v >= min))
+    v = env ? min : def;
+  return v > max ? max : v;
+}
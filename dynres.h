@@ -0,0 +1,28 @@
+/*!\file dynres.h
+ *
+ * \brief rendu à résolution dynamique : la scène est dessinée dans une
+ * cible hors écran dont l'échelle suit un budget de temps par frame,
+ * puis agrandie vers la fenêtre avec un filtre de netteté.
+ * \author Lucien Cartier
+ */
+
+#ifndef _DYNRES_H
+
+#define _DYNRES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  extern void dynresInit(int w, int h);
+  extern void dynresResize(int w, int h);
+  extern void dynresBegin(void);
+  extern void dynresEnd(void);
+  extern float dynresScale(void);
+  extern void dynresQuit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,245 @@
+/*!\file jobs.c
+ *
+ * \brief système de tâches par vol de travail.
+ *
+ * Le thread principal possède la file 0 et chaque worker la sienne. Un
+ * thread dépile ses propres tâches par le bas (les plus récentes, encore
+ * chaudes en cache) et vole celles des autres par le haut ; un verrou par
+ * file suffit vu le grain des tâches. Attendre un compteur (jobsWait)
+ * exécute d'autres tâches plutôt que de bloquer, une tâche peut donc en
+ * attendre d'autres sans monopoliser un thread.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "jobs.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+#define QUEUE_SIZE 256 /* puissance de 2 */
+#define MAX_STATS 32
+
+typedef struct job_t job_t;
+struct job_t {
+  const char *name;
+  jobFunc fn;
+  void *arg;
+  jobCounter *counter;
+};
+
+/* tâches de top (inclus) à bottom (exclu), indices modulo QUEUE_SIZE */
+typedef struct queue_t queue_t;
+struct queue_t {
+  pthread_mutex_t mutex;
+  job_t jobs[QUEUE_SIZE];
+  unsigned int top, bottom;
+};
+
+typedef struct jobStat_t jobStat_t;
+struct jobStat_t {
+  const char *name;
+  unsigned long count;
+  double total, max; /* en ns */
+};
+
+static double now(void);
+static int pop(job_t *job);
+static int runOne(void);
+static void record(const char *name, double ns);
+static void *worker(void *arg);
+
+static queue_t _queues[MAX_THREADS];
+static pthread_t _threads[MAX_THREADS];
+static int _nbQueues = 0, _quit = 0, _queued = 0;
+static unsigned long _steals = 0;
+/* file du thread courant : 0 pour le thread principal */
+static __thread int _self = 0;
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _wake = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t _statsMutex = PTHREAD_MUTEX_INITIALIZER;
+static jobStat_t _stats[MAX_STATS];
+static int _nbStats = 0;
+
+/* nbThreads <= 0 : un thread par cœur, le thread principal compris */
+void jobsInit(int nbThreads) {
+  int i;
+  if (nbThreads <= 0)
+    nbThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  nbThreads = nbThreads < 1 ? 1 : (nbThreads > MAX_THREADS ? MAX_THREADS
+                                                            : nbThreads);
+  _quit = 0;
+  for (i = 0; i < nbThreads; ++i) {
+    pthread_mutex_init(&_queues[i].mutex, NULL);
+    _queues[i].top = _queues[i].bottom = 0;
+  }
+  _nbQueues = 1;
+  for (i = 1; i < nbThreads; ++i) {
+    if (pthread_create(&_threads[i], NULL, worker, (void *)(long)i))
+      break;
+    __atomic_add_fetch(&_nbQueues, 1, __ATOMIC_RELEASE);
+  }
+}
+
+void jobsSubmit(const char *name, jobFunc fn, void *arg,
+                jobCounter *counter) {
+  queue_t *q = &_queues[_self];
+  job_t job = {name, fn, arg, counter};
+  double t;
+  if (counter)
+    __atomic_add_fetch(&counter->pending, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&q->mutex);
+  if (q->bottom - q->top == QUEUE_SIZE) {
+    /* file pleine : la tâche est exécutée sur place */
+    pthread_mutex_unlock(&q->mutex);
+    t = now();
+    fn(arg);
+    record(name, now() - t);
+    if (counter)
+      __atomic_sub_fetch(&counter->pending, 1, __ATOMIC_SEQ_CST);
+    return;
+  }
+  q->jobs[q->bottom++ % QUEUE_SIZE] = job;
+  pthread_mutex_unlock(&q->mutex);
+  __atomic_add_fetch(&_queued, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&_mutex);
+  pthread_cond_signal(&_wake);
+  pthread_mutex_unlock(&_mutex);
+}
+
+int jobsDone(jobCounter *counter) {
+  return __atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) == 0;
+}
+
+/* exécute d'autres tâches en attendant ; le temps passé sans rien trouver
+ * à faire est compté sous le nom « (attente) » */
+void jobsWait(jobCounter *counter) {
+  double t0 = -1.0;
+  while (!jobsDone(counter)) {
+    if (runOne())
+      continue;
+    if (t0 < 0.0)
+      t0 = now();
+    sched_yield();
+  }
+  if (t0 >= 0.0)
+    record("(attente)", now() - t0);
+}
+
+void jobsReport(void) {
+  int i;
+  pthread_mutex_lock(&_statsMutex);
+  fprintf(stderr, "jobs : %-16s %10s %12s %12s (%lu vols)\n", "tache", "nombre",
+          "moyenne (us)", "max (us)", _steals);
+  for (i = 0; i < _nbStats; ++i)
+    fprintf(stderr, "jobs : %-16s %10lu %12.1f %12.1f\n", _stats[i].name,
+            _stats[i].count, _stats[i].total / _stats[i].count / 1000.0,
+            _stats[i].max / 1000.0);
+  pthread_mutex_unlock(&_statsMutex);
+}
+
+/* les tâches encore en file sont exécutées avant l'arrêt des workers */
+void jobsQuit(void) {
+  int i;
+  if (!_nbQueues)
+    return;
+  while (runOne())
+    ;
+  pthread_mutex_lock(&_mutex);
+  _quit = 1;
+  pthread_cond_broadcast(&_wake);
+  pthread_mutex_unlock(&_mutex);
+  for (i = 1; i < _nbQueues; ++i)
+    pthread_join(_threads[i], NULL);
+  for (i = 0; i < _nbQueues; ++i)
+    pthread_mutex_destroy(&_queues[i].mutex);
+  jobsReport();
+  _nbQueues = 0;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1.0e9 + ts.tv_nsec;
+}
+
+/* dans sa propre file par le bas, sinon vol par le haut chez les autres */
+static int pop(job_t *job) {
+  queue_t *q = &_queues[_self];
+  int i, found = 0, n;
+  pthread_mutex_lock(&q->mutex);
+  if (q->bottom != q->top) {
+    *job = q->jobs[--q->bottom % QUEUE_SIZE];
+    found = 1;
+  }
+  pthread_mutex_unlock(&q->mutex);
+  n = __atomic_load_n(&_nbQueues, __ATOMIC_ACQUIRE);
+  for (i = 1; !found && i < n; ++i) {
+    q = &_queues[(_self + i) % n];
+    pthread_mutex_lock(&q->mutex);
+    if (q->bottom != q->top) {
+      *job = q->jobs[q->top++ % QUEUE_SIZE];
+      found = 1;
+      __atomic_add_fetch(&_steals, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&q->mutex);
+  }
+  if (found)
+    __atomic_sub_fetch(&_queued, 1, __ATOMIC_SEQ_CST);
+  return found;
+}
+
+static int runOne(void) {
+  job_t job;
+  double t;
+  if (!pop(&job))
+    return 0;
+  t = now();
+  job.fn(job.arg);
+  record(job.name, now() - t);
+  if (job.counter)
+    __atomic_sub_fetch(&job.counter->pending, 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+static void record(const char *name, double ns) {
+  int i;
+  pthread_mutex_lock(&_statsMutex);
+  for (i = 0; i < _nbStats && strcmp(_stats[i].name, name); ++i)
+    ;
+  if (i == _nbStats && _nbStats < MAX_STATS) {
+    memset(&_stats[i], 0, sizeof _stats[i]);
+    _stats[i].name = name;
+    _nbStats++;
+  }
+  if (i < _nbStats) {
+    _stats[i].count++;
+    _stats[i].total += ns;
+    if (ns > _stats[i].max)
+      _stats[i].max = ns;
+  }
+  pthread_mutex_unlock(&_statsMutex);
+}
+
+static void *worker(void *arg) {
+  _self = (int)(long)arg;
+  for (;;) {
+    if (runOne())
+      continue;
+    pthread_mutex_lock(&_mutex);
+    while (!_quit && !__atomic_load_n(&_queued, __ATOMIC_SEQ_CST))
+      pthread_cond_wait(&_wake, &_mutex);
+    if (_quit && !__atomic_load_n(&_queued, __ATOMIC_SEQ_CST)) {
+      pthread_mutex_unlock(&_mutex);
+      break;
+    }
+    pthread_mutex_unlock(&_mutex);
+  }
+  return NULL;
+}
@@ -0,0 +1,37 @@
+/*!\file jobs.h
+ *
+ * \brief système de tâches par vol de travail : une file par thread, les
+ * threads inactifs volent dans celles des autres. Chaque tâche est
+ * chronométrée et un résumé par nom de tâche est affiché à la fin.
+ * \author Lucien Cartier
+ */
+
+#ifndef _JOBS_H
+
+#define _JOBS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  typedef void (*jobFunc)(void *arg);
+
+  /* nombre de tâches soumises et pas encore terminées */
+  typedef struct jobCounter jobCounter;
+  struct jobCounter {
+    int pending;
+  };
+
+  extern void jobsInit(int nbThreads);
+  extern void jobsSubmit(const char *name, jobFunc fn, void *arg,
+                         jobCounter *counter);
+  extern int jobsDone(jobCounter *counter);
+  extern void jobsWait(jobCounter *counter);
+  extern void jobsReport(void);
+  extern void jobsQuit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
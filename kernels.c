@@ -0,0 +1,122 @@
+/*!\file kernels.c
+ *
+ * \brief noyaux de calcul sans aucun appel OpenGL, extraits de window.c et
+ * assimp.c pour pouvoir être mesurés isolément (voir bench.c).
+ * \author Lucien Cartier
+ */
+
+#include "kernels.h"
+#include <assert.h>
+#include <assimp/cimport.h>
+#include <math.h>
+
+#define kmin(x, y) ((x) < (y) ? (x) : (y))
+#define kmax(x, y) ((y) > (x) ? (y) : (x))
+
+/* analyse d'un bloc de n échantillons 16 bits : FFT puis amplitude
+ * pondérée, répliquée par groupes de 4 dans heights ; magnitudes, si non
+ * NULL, reçoit les n / 4 amplitudes pondérées seules, sans réplication ni
+ * écrêtage. in et out sont les tableaux associés à plan */
+void kernelSpectrum(const short *samples, int n, fftw_plan plan,
+                    fftw_complex *in, fftw_complex *out, short *heights,
+                    float *magnitudes) {
+  int i, j;
+  for (i = 0; i < n; i++)
+    in[i][0] = samples[i] / ((1 << 15) - 1.0);
+  fftw_execute(plan);
+  for (i = 0; i < n >> 2; i++) {
+    double a = sqrt(out[i][0] * out[i][0] + out[i][1] * out[i][1]) *
+               exp(2.0 * i / (double)(n / 4.0));
+    heights[4 * i] = (int)a;
+    if (magnitudes)
+      magnitudes[i] = (float)a;
+    for (j = 1; j < 4; j++)
+      heights[4 * i + j] = kmin(heights[4 * i], 255);
+  }
+}
+
+/* moyenne de la bande [from, to[ cumulée à la valeur précédente, telle
+ * qu'utilisée pour le volume, les basses et les aigus */
+float kernelBand(float prev, const short *heights, int from, int to) {
+  int i;
+  for (i = from; i < to; ++i)
+    prev += (float)heights[i];
+  return prev / (float)(to - from);
+}
+
+/* étend min et max avec les sommets, transformés, du nœud et de ses
+ * enfants */
+void kernelBoundingBox(const struct aiScene *sc, const struct aiNode *nd,
+                       struct aiVector3D *min, struct aiVector3D *max,
+                       struct aiMatrix4x4 *trafo) {
+  struct aiMatrix4x4 prev;
+  unsigned int n = 0, t;
+  prev = *trafo;
+  aiMultiplyMatrix4(trafo, &nd->mTransformation);
+  for (; n < nd->mNumMeshes; ++n) {
+    const struct aiMesh *mesh = sc->mMeshes[nd->mMeshes[n]];
+    for (t = 0; t < mesh->mNumVertices; ++t) {
+      struct aiVector3D tmp = mesh->mVertices[t];
+      aiTransformVecByMatrix4(&tmp, trafo);
+      min->x = kmin(min->x, tmp.x);
+      min->y = kmin(min->y, tmp.y);
+      min->z = kmin(min->z, tmp.z);
+      max->x = kmax(max->x, tmp.x);
+      max->y = kmax(max->y, tmp.y);
+      max->z = kmax(max->z, tmp.z);
+    }
+  }
+  for (n = 0; n < nd->mNumChildren; ++n)
+    kernelBoundingBox(sc, nd->mChildren[n], min, max, trafo);
+  *trafo = prev;
+}
+
+/* nombre de flottants par sommet une fois rangé */
+int kernelPackSize(const struct aiMesh *mesh) {
+  int comp;
+  comp = mesh->mVertices ? 3 : 0;
+  comp += mesh->mNormals ? 3 : 0;
+  comp += mesh->mTextureCoords[0] ? 2 : 0;
+  return comp;
+}
+
+/* range positions, normales puis coordonnées de texture les unes à la suite
+ * des autres (disposition des VBO) ; renvoie le nombre de flottants écrits */
+unsigned int kernelPackVertices(const struct aiMesh *mesh, float *vertices) {
+  unsigned int i = 0, j;
+  for (j = 0; j < mesh->mNumVertices; ++j) {
+    vertices[i++] = mesh->mVertices[j].x;
+    vertices[i++] = mesh->mVertices[j].y;
+    vertices[i++] = mesh->mVertices[j].z;
+  }
+  if (mesh->mNormals) {
+    for (j = 0; j < mesh->mNumVertices; ++j) {
+      vertices[i++] = mesh->mNormals[j].x;
+      vertices[i++] = mesh->mNormals[j].y;
+      vertices[i++] = mesh->mNormals[j].z;
+    }
+  }
+  if (mesh->mTextureCoords[0]) {
+    for (j = 0; j < mesh->mNumVertices; ++j) {
+      vertices[i++] = mesh->mTextureCoords[0][j].x;
+      vertices[i++] = mesh->mTextureCoords[0][j].y;
+    }
+  }
+  return i;
+}
+
+/* copie les triangles (les autres primitives sont ignorées) ; indices doit
+ * pouvoir contenir 3 * mNumFaces entrées, renvoie le nombre d'indices */
+unsigned int kernelPackIndices(const struct aiMesh *mesh,
+                               unsigned int *indices) {
+  unsigned int i = 0, j;
+  for (j = 0; j < mesh->mNumFaces; ++j) {
+    assert(mesh->mFaces[j].mNumIndices < 4);
+    if (mesh->mFaces[j].mNumIndices != 3)
+      continue;
+    indices[i++] = mesh->mFaces[j].mIndices[0];
+    indices[i++] = mesh->mFaces[j].mIndices[1];
+    indices[i++] = mesh->mFaces[j].mIndices[2];
+  }
+  return i;
+}
@@ -0,0 +1,46 @@
+/*!\file kernels.h
+ *
+ * \brief noyaux de calcul sans aucun appel OpenGL : analyse du spectre
+ * audio, réductions par bandes, boîte englobante et rangement des
+ * sommets. Partagés par la démo et par le programme de mesures (bench).
+ * \author Lucien Cartier
+ */
+
+#ifndef _KERNELS_H
+
+#define _KERNELS_H
+
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <fftw3.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* options de post-traitement utilisées lors de l'import Assimp */
+#define KERNEL_AI_FLAGS                                                        \
+  (aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_CalcTangentSpace |   \
+   aiProcess_Triangulate | aiProcess_JoinIdenticalVertices |                  \
+   aiProcess_SortByPType)
+
+  extern void kernelSpectrum(const short *samples, int n, fftw_plan plan,
+                             fftw_complex *in, fftw_complex *out,
+                             short *heights, float *magnitudes);
+  extern float kernelBand(float prev, const short *heights, int from, int to);
+  extern void kernelBoundingBox(const struct aiScene *sc,
+                                const struct aiNode *nd,
+                                struct aiVector3D *min,
+                                struct aiVector3D *max,
+                                struct aiMatrix4x4 *trafo);
+  extern int kernelPackSize(const struct aiMesh *mesh);
+  extern unsigned int kernelPackVertices(const struct aiMesh *mesh,
+                                         float *vertices);
+  extern unsigned int kernelPackIndices(const struct aiMesh *mesh,
+                                        unsigned int *indices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
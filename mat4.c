@@ -0,0 +1,212 @@
+/*!\file mat4.c
+ *
+ * \brief matrices 4x4 et piles de matrices désignées par un identifiant.
+ *
+ * Le produit est vectorisé en SSE (une ligne du résultat par combinaison
+ * linéaire des lignes du second opérande), avec repli scalaire. Les piles
+ * n'ont aucun état global « courant » : chaque appel précise sa pile, ce
+ * qui permet au rendu OpenGL et au rasteriseur CPU de les partager.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "mat4.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#define STACK_INIT 16
+
+typedef struct mat4stack_t mat4stack_t;
+struct mat4stack_t {
+  float *m; /* size matrices, la courante à l'indice top */
+  int top, size;
+};
+
+static mat4stack_t *stackOf(unsigned int stack);
+
+static mat4stack_t *_stacks = NULL;
+static unsigned int _nbStacks = 0;
+
+/* renvoie un identifiant non nul, la pile contient l'identité ; les
+ * emplacements des piles supprimées sont réutilisés */
+unsigned int mat4GenStack(void) {
+  mat4stack_t *s;
+  unsigned int i;
+  for (i = 0; i < _nbStacks && _stacks[i].m; ++i)
+    ;
+  if (i == _nbStacks) {
+    _stacks = realloc(_stacks, (_nbStacks + 1) * sizeof *_stacks);
+    assert(_stacks);
+    _nbStacks++;
+  }
+  s = &_stacks[i];
+  s->size = STACK_INIT;
+  s->top = 0;
+  s->m = malloc(s->size * 16 * sizeof *s->m);
+  assert(s->m);
+  mat4LoadIdentity(i + 1);
+  return i + 1;
+}
+
+void mat4DeleteStack(unsigned int stack) {
+  mat4stack_t *s = stackOf(stack);
+  unsigned int i;
+  free(s->m);
+  s->m = NULL;
+  for (i = 0; i < _nbStacks && !_stacks[i].m; ++i)
+    ;
+  if (i == _nbStacks) {
+    free(_stacks);
+    _stacks = NULL;
+    _nbStacks = 0;
+  }
+}
+
+const float *mat4Top(unsigned int stack) {
+  mat4stack_t *s = stackOf(stack);
+  return &s->m[16 * s->top];
+}
+
+void mat4LoadIdentity(unsigned int stack) {
+  static const float id[16] = {1, 0, 0, 0, 0, 1, 0, 0,
+                               0, 0, 1, 0, 0, 0, 0, 1};
+  mat4Load(stack, id);
+}
+
+void mat4Load(unsigned int stack, const float *m) {
+  mat4stack_t *s = stackOf(stack);
+  memcpy(&s->m[16 * s->top], m, 16 * sizeof *m);
+}
+
+void mat4Push(unsigned int stack) {
+  mat4stack_t *s = stackOf(stack);
+  if (s->top + 1 == s->size) {
+    s->size *= 2;
+    s->m = realloc(s->m, s->size * 16 * sizeof *s->m);
+    assert(s->m);
+  }
+  memcpy(&s->m[16 * (s->top + 1)], &s->m[16 * s->top], 16 * sizeof *s->m);
+  s->top++;
+}
+
+void mat4Pop(unsigned int stack) {
+  mat4stack_t *s = stackOf(stack);
+  assert(s->top > 0);
+  s->top--;
+}
+
+void mat4Mult(unsigned int stack, const float *m) {
+  mat4stack_t *s = stackOf(stack);
+  float *c = &s->m[16 * s->top];
+  mat4Multiply(c, c, m);
+}
+
+/* seule la dernière colonne change */
+void mat4Translate(unsigned int stack, float x, float y, float z) {
+  mat4stack_t *s = stackOf(stack);
+  float *c = &s->m[16 * s->top];
+  int i;
+  for (i = 0; i < 4; ++i)
+    c[4 * i + 3] += c[4 * i] * x + c[4 * i + 1] * y + c[4 * i + 2] * z;
+}
+
+void mat4Rotate(unsigned int stack, float angle, float x, float y, float z) {
+  float n = sqrtf(x * x + y * y + z * z), c, s, d;
+  if (n <= 0.0f)
+    return;
+  x /= n;
+  y /= n;
+  z /= n;
+  angle *= (float)M_PI / 180.0f;
+  c = cosf(angle);
+  s = sinf(angle);
+  d = 1.0f - c;
+  {
+    const float m[16] = {x * x * d + c,     x * y * d - z * s, x * z * d + y * s,
+                         0,                 y * x * d + z * s, y * y * d + c,
+                         y * z * d - x * s, 0,                 z * x * d - y * s,
+                         z * y * d + x * s, z * z * d + c,     0,
+                         0,                 0,                 0,
+                         1};
+    mat4Mult(stack, m);
+  }
+}
+
+/* seules les trois premières colonnes changent */
+void mat4Scale(unsigned int stack, float x, float y, float z) {
+  mat4stack_t *s = stackOf(stack);
+  float *c = &s->m[16 * s->top];
+  int i;
+  for (i = 0; i < 4; ++i) {
+    c[4 * i] *= x;
+    c[4 * i + 1] *= y;
+    c[4 * i + 2] *= z;
+  }
+}
+
+void mat4Frustum(unsigned int stack, float l, float r, float b, float t,
+                 float n, float f) {
+  const float m[16] = {2 * n / (r - l), 0, (r + l) / (r - l), 0,
+                       0, 2 * n / (t - b), (t + b) / (t - b), 0,
+                       0, 0, -(f + n) / (f - n), -2 * f * n / (f - n),
+                       0, 0, -1, 0};
+  mat4Mult(stack, m);
+}
+
+/* res = a * b ; res peut être a ou b */
+void mat4Multiply(float *res, const float *a, const float *b) {
+#ifdef __SSE__
+  __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4),
+         b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12), r;
+  int i;
+  /* la ligne i de a est lue avant que la ligne i de res soit écrite */
+  for (i = 0; i < 4; ++i) {
+    r = _mm_mul_ps(_mm_set1_ps(a[4 * i]), b0);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[4 * i + 1]), b1));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[4 * i + 2]), b2));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[4 * i + 3]), b3));
+    _mm_storeu_ps(res + 4 * i, r);
+  }
+#else
+  float tmp[16];
+  int i, j;
+  for (i = 0; i < 4; ++i)
+    for (j = 0; j < 4; ++j)
+      tmp[4 * i + j] = a[4 * i] * b[j] + a[4 * i + 1] * b[4 + j] +
+                       a[4 * i + 2] * b[8 + j] + a[4 * i + 3] * b[12 + j];
+  memcpy(res, tmp, sizeof tmp);
+#endif
+}
+
+/* transposée de l'inverse du bloc 3x3 de mv, i.e. sa comatrice divisée par
+ * le déterminant, rangée dans une 4x4 (disposition std140) */
+void mat4NormalMatrix(float *res, const float *mv) {
+  float c[9], det;
+  int i, j;
+  c[0] = mv[5] * mv[10] - mv[6] * mv[9];
+  c[1] = mv[6] * mv[8] - mv[4] * mv[10];
+  c[2] = mv[4] * mv[9] - mv[5] * mv[8];
+  c[3] = mv[2] * mv[9] - mv[1] * mv[10];
+  c[4] = mv[0] * mv[10] - mv[2] * mv[8];
+  c[5] = mv[1] * mv[8] - mv[0] * mv[9];
+  c[6] = mv[1] * mv[6] - mv[2] * mv[5];
+  c[7] = mv[2] * mv[4] - mv[0] * mv[6];
+  c[8] = mv[0] * mv[5] - mv[1] * mv[4];
+  det = mv[0] * c[0] + mv[1] * c[1] + mv[2] * c[2];
+  det = fabsf(det) > 1e-20f ? 1.0f / det : 1.0f;
+  memset(res, 0, 16 * sizeof *res);
+  for (i = 0; i < 3; ++i)
+    for (j = 0; j < 3; ++j)
+      res[4 * i + j] = c[3 * i + j] * det;
+  res[15] = 1.0f;
+}
+
+static mat4stack_t *stackOf(unsigned int stack) {
+  assert(stack > 0 && stack <= _nbStacks && _stacks[stack - 1].m);
+  return &_stacks[stack - 1];
+}
@@ -0,0 +1,41 @@
+/*!\file mat4.h
+ *
+ * \brief matrices 4x4 et piles de matrices désignées par un identifiant,
+ * en remplacement des matrices nommées de GL4Dummies.
+ *
+ * Mêmes conventions que gl4du : lignes majeures, les transformations
+ * multiplient à droite le sommet de la pile.
+ * \author Lucien Cartier
+ */
+
+#ifndef _MAT4_H
+
+#define _MAT4_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  extern unsigned int mat4GenStack(void);
+  extern void mat4DeleteStack(unsigned int stack);
+  extern const float *mat4Top(unsigned int stack);
+  extern void mat4LoadIdentity(unsigned int stack);
+  extern void mat4Load(unsigned int stack, const float *m);
+  extern void mat4Push(unsigned int stack);
+  extern void mat4Pop(unsigned int stack);
+  extern void mat4Mult(unsigned int stack, const float *m);
+  extern void mat4Translate(unsigned int stack, float x, float y, float z);
+  extern void mat4Rotate(unsigned int stack, float angle, float x, float y,
+                         float z);
+  extern void mat4Scale(unsigned int stack, float x, float y, float z);
+  extern void mat4Frustum(unsigned int stack, float l, float r, float b,
+                          float t, float n, float f);
+
+  extern void mat4Multiply(float *res, const float *a, const float *b);
+  extern void mat4NormalMatrix(float *res, const float *mv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,690 @@
+/*!\file objloader.c
+ *
+ * \brief chargeur OBJ/MTL rapide et parallèle.
+ *
+ * Le fichier est projeté en mémoire (mmap) puis découpé en morceaux
+ * alignés sur les fins de ligne, analysés en parallèle. Les indices
+ * relatifs (négatifs) sont résolus une fois les décalages de chaque
+ * morceau connus, puis chaque groupe usemtl est transformé, en parallèle
+ * lui aussi, en un maillage dont les triplets v/vt/vn sont dédupliqués
+ * par table de hachage. Les tampons produits sont directement ceux que
+ * sceneMkVAOs envoie à OpenGL.
+ *
+ * Seuls les polygones (triangulés en éventail), positions, normales,
+ * coordonnées de texture et groupes usemtl sont pris en compte ; un
+ * fichier sans normales est refusé pour laisser Assimp les générer.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "objloader.h"
+#include "pack.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+#define MAX_POLYGON 64
+#define MISSING INT_MIN
+/* un indice relatif est stocké, en attendant la résolution, sous la forme
+ * (indice dans le morceau - REL_BIAS), donc négatif */
+#define REL_BIAS (1 << 30)
+
+typedef struct buffer_t buffer_t;
+struct buffer_t {
+  void *data;
+  size_t n, size; /* en éléments */
+};
+
+typedef struct group_t group_t;
+struct group_t {
+  const char *name;
+  int len;
+  unsigned int first; /* premier triangle du groupe */
+};
+
+typedef struct chunk_t chunk_t;
+struct chunk_t {
+  const char *begin, *end;
+  buffer_t v, vt, vn, corners, groups;
+  const char *mtllib;
+  int mtllibLen, error;
+  /* décalages globaux, calculés après la première passe */
+  unsigned int vOffset, vtOffset, vnOffset, triOffset;
+  struct loader_t *ld;
+};
+
+typedef struct loader_t loader_t;
+struct loader_t {
+  chunk_t chunks[MAX_THREADS];
+  int nbChunks, nextMesh;
+  unsigned int nbV, nbVt, nbVn, nbTris;
+  float *v, *vt, *vn;
+  int *corners;
+  group_t *groups;
+  objScene *scene;
+};
+
+static const char *mapFile(const char *filename, size_t *size, int *mapped);
+static void *reserve(buffer_t *b, size_t nb, size_t elt);
+static const char *parseFloat(const char *p, const char *end, float *res);
+static const char *parseIndex(const char *p, const char *end, int *res);
+static int parseMtl(const char *filename, objScene *scene);
+static void runParallel(void *(*fn)(void *), void *args, size_t stride,
+                        int n);
+static void *parseChunk(void *arg);
+static void *resolveChunk(void *arg);
+static void *buildMeshes(void *arg);
+
+objScene *objLoad(const char *filename, int nbThreads) {
+  size_t size, i;
+  const char *data;
+  unsigned int k, nbGroups;
+  int c, mapped;
+  loader_t *ld;
+  objScene *scene;
+  if (!(data = mapFile(filename, &size, &mapped)))
+    return NULL;
+  if (nbThreads <= 0)
+    nbThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  nbThreads = nbThreads < 1 ? 1
+                            : (nbThreads > MAX_THREADS ? MAX_THREADS
+                                                       : nbThreads);
+  ld = calloc(1, sizeof *ld);
+  scene = calloc(1, sizeof *scene);
+  if (!ld || !scene)
+    goto fail;
+  ld->scene = scene;
+
+  /* morceaux alignés sur les fins de ligne **********************************/
+  for (c = 0, i = 0; c < nbThreads && i < size; ++c) {
+    size_t e = c == nbThreads - 1 ? size : (size * (c + 1)) / nbThreads;
+    const char *nl;
+    if (e < i)
+      e = i;
+    nl = e < size ? memchr(data + e, '\n', size - e) : NULL;
+    e = nl ? (size_t)(nl - data) + 1 : size;
+    ld->chunks[c].begin = data + i;
+    ld->chunks[c].end = data + e;
+    ld->chunks[c].ld = ld;
+    i = e;
+  }
+  ld->nbChunks = c;
+  runParallel(parseChunk, ld->chunks, sizeof ld->chunks[0], ld->nbChunks);
+
+  /* décalages de chaque morceau *********************************************/
+  for (c = 0; c < ld->nbChunks; ++c) {
+    chunk_t *ch = &ld->chunks[c];
+    if (ch->error)
+      goto fail;
+    ch->vOffset = ld->nbV;
+    ch->vtOffset = ld->nbVt;
+    ch->vnOffset = ld->nbVn;
+    ch->triOffset = ld->nbTris;
+    ld->nbV += ch->v.n / 3;
+    ld->nbVt += ch->vt.n / 2;
+    ld->nbVn += ch->vn.n / 3;
+    ld->nbTris += ch->corners.n / 9;
+  }
+  if (!ld->nbTris || !ld->nbVn)
+    goto fail;
+  ld->v = malloc(3 * ld->nbV * sizeof *ld->v);
+  ld->vt = malloc((2 * ld->nbVt + 1) * sizeof *ld->vt);
+  ld->vn = malloc(3 * ld->nbVn * sizeof *ld->vn);
+  ld->corners = malloc(9 * ld->nbTris * sizeof *ld->corners);
+  if (!ld->v || !ld->vt || !ld->vn || !ld->corners)
+    goto fail;
+  runParallel(resolveChunk, ld->chunks, sizeof ld->chunks[0], ld->nbChunks);
+  for (c = 0; c < ld->nbChunks; ++c)
+    if (ld->chunks[c].error)
+      goto fail;
+
+  /* matériaux ****************************************************************/
+  for (c = 0; c < ld->nbChunks; ++c)
+    if (ld->chunks[c].mtllib) {
+      char path[BUFSIZ];
+      const char *slash = strrchr(filename, '/');
+      int dirLen = slash ? (int)(slash - filename) + 1 : 0;
+      snprintf(path, sizeof path, "%.*s%.*s", dirLen, filename,
+               ld->chunks[c].mtllibLen, ld->chunks[c].mtllib);
+      if (!parseMtl(path, scene))
+        fprintf(stderr, "objLoad: impossible de lire %s\n", path);
+      break;
+    }
+
+  /* un maillage par groupe usemtl non vide **********************************/
+  for (nbGroups = 1, c = 0; c < ld->nbChunks; ++c)
+    nbGroups += ld->chunks[c].groups.n;
+  if (!(ld->groups = malloc((nbGroups + 1) * sizeof *ld->groups)))
+    goto fail;
+  ld->groups[0].name = NULL;
+  ld->groups[0].len = 0;
+  ld->groups[0].first = 0;
+  for (nbGroups = 1, c = 0; c < ld->nbChunks; ++c) {
+    const group_t *g = ld->chunks[c].groups.data;
+    for (i = 0; i < ld->chunks[c].groups.n; ++i, ++nbGroups) {
+      ld->groups[nbGroups] = g[i];
+      ld->groups[nbGroups].first += ld->chunks[c].triOffset;
+    }
+  }
+  ld->groups[nbGroups].first = ld->nbTris; /* sentinelle */
+  if (!(scene->meshes = calloc(nbGroups, sizeof *scene->meshes)))
+    goto fail;
+  for (k = 0; k < nbGroups; ++k) {
+    group_t *g = &ld->groups[k];
+    objMesh *m = &scene->meshes[scene->nbMeshes];
+    unsigned int j;
+    if (g->first == ld->groups[k + 1].first)
+      continue;
+    for (j = 0; j < scene->nbMaterials; ++j)
+      if (g->name && (int)strlen(scene->materials[j].name) == g->len &&
+          !strncmp(scene->materials[j].name, g->name, g->len))
+        break;
+    if (j == scene->nbMaterials) {
+      /* matériau par défaut, ajouté à la demande */
+      for (j = 0; j < scene->nbMaterials; ++j)
+        if (!strcmp(scene->materials[j].name, "DefaultMaterial"))
+          break;
+      if (j == scene->nbMaterials) {
+        objMaterial *mt = realloc(scene->materials,
+                                  (j + 1) * sizeof *scene->materials);
+        if (!mt)
+          goto fail;
+        scene->materials = mt;
+        memset(&mt[j], 0, sizeof mt[j]);
+        strcpy(mt[j].name, "DefaultMaterial");
+        mt[j].ambient[0] = mt[j].ambient[1] = mt[j].ambient[2] = 0.2f;
+        mt[j].diffuse[0] = mt[j].diffuse[1] = mt[j].diffuse[2] = 0.8f;
+        mt[j].ambient[3] = mt[j].diffuse[3] = mt[j].specular[3] =
+            mt[j].emission[3] = mt[j].opacity = 1.0f;
+        scene->nbMaterials++;
+      }
+    }
+    m->material = j;
+    /* first/count provisoires, remplacés par buildMeshes */
+    m->nbVertices = g->first;
+    m->count = 3 * (ld->groups[k + 1].first - g->first);
+    scene->nbMeshes++;
+  }
+  runParallel(buildMeshes, ld, 0, nbThreads < (int)scene->nbMeshes
+                                      ? nbThreads
+                                      : (int)scene->nbMeshes);
+  for (k = 0; k < scene->nbMeshes; ++k)
+    if (!scene->meshes[k].vertices || !scene->meshes[k].indices)
+      goto fail;
+
+  /* boîte englobante *********************************************************/
+  scene->min[0] = scene->min[1] = scene->min[2] = 1e10f;
+  scene->max[0] = scene->max[1] = scene->max[2] = -1e10f;
+  for (k = 0; k < scene->nbMeshes; ++k) {
+    const objMesh *m = &scene->meshes[k];
+    unsigned int j;
+    int a;
+    for (j = 0; j < m->nbVertices; ++j)
+      for (a = 0; a < 3; ++a) {
+        scene->min[a] = fminf(scene->min[a], m->vertices[3 * j + a]);
+        scene->max[a] = fmaxf(scene->max[a], m->vertices[3 * j + a]);
+      }
+  }
+  goto done;
+
+fail:
+  objFree(scene);
+  scene = NULL;
+done:
+  if (ld) {
+    for (c = 0; c < ld->nbChunks; ++c) {
+      free(ld->chunks[c].v.data);
+      free(ld->chunks[c].vt.data);
+      free(ld->chunks[c].vn.data);
+      free(ld->chunks[c].corners.data);
+      free(ld->chunks[c].groups.data);
+    }
+    free(ld->v);
+    free(ld->vt);
+    free(ld->vn);
+    free(ld->corners);
+    free(ld->groups);
+    free(ld);
+  }
+  if (mapped)
+    munmap((void *)data, size);
+  return scene;
+}
+
+void objFree(objScene *scene) {
+  unsigned int i;
+  if (!scene)
+    return;
+  if (scene->meshes) {
+    for (i = 0; i < scene->nbMeshes; ++i) {
+      free(scene->meshes[i].vertices);
+      free(scene->meshes[i].indices);
+    }
+    free(scene->meshes);
+  }
+  free(scene->materials);
+  free(scene);
+}
+
+/* depuis l'archive des ressources si elle le contient, sans copie ;
+ * *mapped indique s'il faudra libérer la projection */
+static const char *mapFile(const char *filename, size_t *size, int *mapped) {
+  struct stat st;
+  void *p;
+  int fd;
+  *mapped = 0;
+  if ((p = (void *)packData(filename, size)) != NULL)
+    return p;
+  if ((fd = open(filename, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+    close(fd);
+    return NULL;
+  }
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return NULL;
+  /* tous les morceaux sont lus en même temps */
+  madvise(p, st.st_size, MADV_WILLNEED);
+  *size = st.st_size;
+  *mapped = 1;
+  return p;
+}
+
+static void *reserve(buffer_t *b, size_t nb, size_t elt) {
+  if (b->n + nb > b->size) {
+    size_t size = b->size ? 2 * b->size : 1024;
+    void *d;
+    while (size < b->n + nb)
+      size *= 2;
+    if (!(d = realloc(b->data, size * elt)))
+      return NULL;
+    b->data = d;
+    b->size = size;
+  }
+  return (char *)b->data + b->n * elt;
+}
+
+#define IS_BLANK(c) ((c) == ' ' || (c) == '\t' || (c) == '\r')
+
+static const char *skipBlanks(const char *p, const char *end) {
+  while (p < end && IS_BLANK(*p))
+    p++;
+  return p;
+}
+
+/* analyse décimale directe : mantisse entière sur 64 bits puis une seule
+ * mise à l'échelle par une puissance de 10 ; renvoie NULL sans chiffre */
+static const char *parseFloat(const char *p, const char *end, float *res) {
+  static const double p10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+  uint64_t m = 0;
+  int neg = 0, e = 0, digits = 0;
+  double r;
+  p = skipBlanks(p, end);
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = *p++ == '-';
+  for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+    if (m < 100000000000000000ULL)
+      m = 10 * m + (*p - '0');
+    else
+      e++;
+  if (p < end && *p == '.')
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+      if (m < 100000000000000000ULL) {
+        m = 10 * m + (*p - '0');
+        e--;
+      }
+  if (!digits)
+    return NULL;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    int eneg = 0, x = 0;
+    const char *q = p + 1;
+    if (q < end && (*q == '-' || *q == '+'))
+      eneg = *q++ == '-';
+    if (q < end && *q >= '0' && *q <= '9') {
+      for (; q < end && *q >= '0' && *q <= '9'; ++q)
+        x = x < 10000 ? 10 * x + (*q - '0') : x;
+      e += eneg ? -x : x;
+      p = q;
+    }
+  }
+  r = (double)m;
+  if (e < 0)
+    r = e >= -22 ? r / p10[-e] : r * pow(10.0, e);
+  else if (e > 0)
+    r = e <= 22 ? r * p10[e] : r * pow(10.0, e);
+  *res = (float)(neg ? -r : r);
+  return p;
+}
+
+static const char *parseIndex(const char *p, const char *end, int *res) {
+  int neg = 0, x = 0;
+  const char *q;
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = *p++ == '-';
+  for (q = p; p < end && *p >= '0' && *p <= '9'; ++p)
+    x = 10 * x + (*p - '0');
+  if (p == q)
+    return NULL;
+  *res = neg ? -x : x;
+  return p;
+}
+
+/* compare le mot-clé en début de ligne, suivi d'un blanc */
+static int keyword(const char *p, const char *eol, const char *kw) {
+  size_t l = strlen(kw);
+  return (size_t)(eol - p) > l && !memcmp(p, kw, l) && IS_BLANK(p[l]);
+}
+
+static int parseFloats(buffer_t *b, const char *p, const char *eol, int n,
+                       int required) {
+  float *f = reserve(b, n, sizeof *f);
+  int i;
+  if (!f)
+    return 0;
+  for (i = 0; i < n; ++i) {
+    const char *q = parseFloat(p, eol, &f[i]);
+    if (!q) {
+      if (i < required)
+        return 0;
+      f[i] = 0.0f;
+    } else
+      p = q;
+  }
+  b->n += n;
+  return 1;
+}
+
+/* encode un indice OBJ (base 1, éventuellement relatif) */
+static int encode(int idx, size_t localCount) {
+  return idx > 0 ? idx - 1 : (int)localCount + idx - REL_BIAS;
+}
+
+static int parseFace(chunk_t *c, const char *p, const char *eol) {
+  int poly[MAX_POLYGON][3], n = 0, k, *t;
+  while ((p = skipBlanks(p, eol)) < eol) {
+    int v, vt = MISSING, vn = MISSING;
+    if (n == MAX_POLYGON || !(p = parseIndex(p, eol, &v)) || !v)
+      return 0;
+    if (p < eol && *p == '/') {
+      const char *q;
+      if (++p < eol && *p != '/') {
+        if (!(p = parseIndex(p, eol, &vt)) || !vt)
+          return 0;
+        vt = encode(vt, c->vt.n / 2);
+      }
+      if (p < eol && *p == '/') {
+        if (!(q = parseIndex(++p, eol, &vn)) || !vn)
+          return 0;
+        p = q;
+        vn = encode(vn, c->vn.n / 3);
+      }
+    }
+    poly[n][0] = encode(v, c->v.n / 3);
+    poly[n][1] = vt;
+    poly[n][2] = vn;
+    n++;
+    while (p < eol && !IS_BLANK(*p))
+      p++;
+  }
+  if (n < 3)
+    return 1; /* points et lignes ignorés */
+  if (!(t = reserve(&c->corners, 9 * (n - 2), sizeof *t)))
+    return 0;
+  for (k = 1; k + 1 < n; ++k) {
+    memcpy(t, poly[0], sizeof poly[0]);
+    memcpy(t + 3, poly[k], sizeof poly[k]);
+    memcpy(t + 6, poly[k + 1], sizeof poly[k + 1]);
+    t += 9;
+  }
+  c->corners.n += 9 * (n - 2);
+  return 1;
+}
+
+/* dernier mot de la ligne (les options de map_Kd le précèdent) */
+static const char *lastToken(const char *p, const char *eol, int *len) {
+  const char *b, *e = eol;
+  while (e > p && IS_BLANK(e[-1]))
+    e--;
+  for (b = e; b > p && !IS_BLANK(b[-1]); --b)
+    ;
+  *len = (int)(e - b);
+  return b;
+}
+
+static void *parseChunk(void *arg) {
+  chunk_t *c = arg;
+  const char *p = c->begin, *eol;
+  for (; p < c->end && !c->error; p = eol + 1) {
+    const char *s;
+    if (!(eol = memchr(p, '\n', c->end - p)))
+      eol = c->end;
+    s = skipBlanks(p, eol);
+    if (eol - s < 2)
+      continue;
+    if (s[0] == 'v' && IS_BLANK(s[1]))
+      c->error = !parseFloats(&c->v, s + 2, eol, 3, 3);
+    else if (s[0] == 'v' && s[1] == 't' && eol - s > 2 && IS_BLANK(s[2]))
+      c->error = !parseFloats(&c->vt, s + 3, eol, 2, 1);
+    else if (s[0] == 'v' && s[1] == 'n' && eol - s > 2 && IS_BLANK(s[2]))
+      c->error = !parseFloats(&c->vn, s + 3, eol, 3, 3);
+    else if (s[0] == 'f' && IS_BLANK(s[1]))
+      c->error = !parseFace(c, s + 2, eol);
+    else if (keyword(s, eol, "usemtl")) {
+      group_t *g = reserve(&c->groups, 1, sizeof *g);
+      if (!g) {
+        c->error = 1;
+        continue;
+      }
+      g->name = lastToken(s + 6, eol, &g->len);
+      g->first = c->corners.n / 9;
+      c->groups.n++;
+    } else if (keyword(s, eol, "mtllib") && !c->mtllib)
+      c->mtllib = lastToken(s + 6, eol, &c->mtllibLen);
+  }
+  return NULL;
+}
+
+/* résolution des indices relatifs et recopie aux décalages globaux */
+static void *resolveChunk(void *arg) {
+  chunk_t *c = arg;
+  loader_t *ld = c->ld;
+  const unsigned int offsets[3] = {c->vOffset, c->vtOffset, c->vnOffset},
+                     limits[3] = {ld->nbV, ld->nbVt, ld->nbVn};
+  int *dst = &ld->corners[9 * c->triOffset];
+  const int *src = c->corners.data;
+  size_t i;
+  if (c->v.n)
+    memcpy(&ld->v[3 * c->vOffset], c->v.data, c->v.n * sizeof *ld->v);
+  if (c->vt.n)
+    memcpy(&ld->vt[2 * c->vtOffset], c->vt.data, c->vt.n * sizeof *ld->vt);
+  if (c->vn.n)
+    memcpy(&ld->vn[3 * c->vnOffset], c->vn.data, c->vn.n * sizeof *ld->vn);
+  for (i = 0; i < c->corners.n; ++i) {
+    int a = i % 3, x = src[i];
+    if (x == MISSING) {
+      dst[i] = MISSING;
+      continue;
+    }
+    if (x < 0)
+      x += REL_BIAS + offsets[a];
+    if (x < 0 || (unsigned int)x >= limits[a]) {
+      c->error = 1;
+      return NULL;
+    }
+    dst[i] = x;
+  }
+  return NULL;
+}
+
+static unsigned int hash3(const int *k) {
+  return ((unsigned int)k[0] * 73856093u) ^ ((unsigned int)k[1] * 19349663u) ^
+         ((unsigned int)k[2] * 83492791u);
+}
+
+static void buildMesh(loader_t *ld, objMesh *m) {
+  unsigned int first = m->nbVertices, nc = m->count, size = 16, i, nu = 0,
+               j;
+  const int *corners = &ld->corners[9 * first];
+  unsigned int *table, *uniq, *indices;
+  float *vertices, *n, *t;
+  while (size < 2 * nc)
+    size *= 2;
+  table = calloc(size, sizeof *table);
+  uniq = malloc(nc * sizeof *uniq);
+  indices = malloc(nc * sizeof *indices);
+  if (!table || !uniq || !indices)
+    goto fail;
+  m->hasNormals = m->hasTexCoords = 0;
+  /* table : indice du sommet + 1, 0 pour une case vide */
+  for (i = 0; i < nc; ++i) {
+    const int *k = &corners[3 * i];
+    unsigned int h = hash3(k) & (size - 1);
+    while (table[h]) {
+      const int *u = &corners[3 * uniq[table[h] - 1]];
+      if (u[0] == k[0] && u[1] == k[1] && u[2] == k[2])
+        break;
+      h = (h + 1) & (size - 1);
+    }
+    if (!table[h]) {
+      uniq[nu] = i;
+      table[h] = ++nu;
+      m->hasTexCoords |= k[1] != MISSING;
+      m->hasNormals |= k[2] != MISSING;
+    }
+    indices[i] = table[h] - 1;
+  }
+  vertices = malloc((3 + 3 * m->hasNormals + 2 * m->hasTexCoords) * nu *
+                    sizeof *vertices);
+  if (!vertices)
+    goto fail;
+  n = vertices + 3 * nu;
+  t = n + (m->hasNormals ? 3 * nu : 0);
+  for (j = 0; j < nu; ++j) {
+    const int *k = &corners[3 * uniq[j]];
+    memcpy(&vertices[3 * j], &ld->v[3 * k[0]], 3 * sizeof *vertices);
+    if (m->hasNormals) {
+      if (k[2] != MISSING)
+        memcpy(&n[3 * j], &ld->vn[3 * k[2]], 3 * sizeof *n);
+      else
+        n[3 * j] = n[3 * j + 1] = n[3 * j + 2] = 0.0f;
+    }
+    if (m->hasTexCoords) {
+      if (k[1] != MISSING)
+        memcpy(&t[2 * j], &ld->vt[2 * k[1]], 2 * sizeof *t);
+      else
+        t[2 * j] = t[2 * j + 1] = 0.0f;
+    }
+  }
+  m->vertices = vertices;
+  m->indices = indices;
+  m->nbVertices = nu;
+  free(table);
+  free(uniq);
+  return;
+fail:
+  free(table);
+  free(uniq);
+  free(indices);
+}
+
+static void *buildMeshes(void *arg) {
+  loader_t *ld = arg;
+  int i;
+  while ((i = __atomic_fetch_add(&ld->nextMesh, 1, __ATOMIC_RELAXED)) <
+         (int)ld->scene->nbMeshes)
+    buildMesh(ld, &ld->scene->meshes[i]);
+  return NULL;
+}
+
+static void runParallel(void *(*fn)(void *), void *args, size_t stride,
+                        int n) {
+  pthread_t th[MAX_THREADS];
+  int i, started;
+  for (i = 1; i < n; ++i)
+    if (pthread_create(&th[i], NULL, fn, (char *)args + i * stride))
+      break;
+  started = i;
+  fn(args);
+  for (i = 1; i < started; ++i)
+    pthread_join(th[i], NULL);
+  /* repli séquentiel si un thread n'a pas pu être créé */
+  for (i = started; i < n; ++i)
+    fn((char *)args + i * stride);
+}
+
+static void copyName(char *dst, const char *src, int len) {
+  len = len < OBJ_NAME_MAX - 1 ? len : OBJ_NAME_MAX - 1;
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+static int parseMtl(const char *filename, objScene *scene) {
+  size_t size;
+  const char *data, *p, *eol, *end;
+  objMaterial *m = NULL;
+  int mapped;
+  if (!(data = mapFile(filename, &size, &mapped)))
+    return 0;
+  for (p = data, end = data + size; p < end; p = eol + 1) {
+    const char *s;
+    int len;
+    if (!(eol = memchr(p, '\n', end - p)))
+      eol = end;
+    s = skipBlanks(p, eol);
+    if (keyword(s, eol, "newmtl")) {
+      objMaterial *mt = realloc(scene->materials,
+                                (scene->nbMaterials + 1) * sizeof *mt);
+      if (!mt)
+        break;
+      scene->materials = mt;
+      m = &mt[scene->nbMaterials++];
+      memset(m, 0, sizeof *m);
+      s = lastToken(s + 6, eol, &len);
+      copyName(m->name, s, len);
+      m->ambient[0] = m->ambient[1] = m->ambient[2] = 0.2f;
+      m->diffuse[0] = m->diffuse[1] = m->diffuse[2] = 0.8f;
+      m->ambient[3] = m->diffuse[3] = m->specular[3] = m->emission[3] =
+          m->opacity = 1.0f;
+    } else if (!m)
+      continue;
+    else if (keyword(s, eol, "Ka") || keyword(s, eol, "Kd") ||
+             keyword(s, eol, "Ks") || keyword(s, eol, "Ke")) {
+      float *c = s[1] == 'a' ? m->ambient
+                             : (s[1] == 'd' ? m->diffuse
+                                            : (s[1] == 's' ? m->specular
+                                                           : m->emission));
+      const char *q = s + 2;
+      int i;
+      for (i = 0; i < 3 && q; ++i)
+        q = parseFloat(q, eol, &c[i]);
+    } else if (keyword(s, eol, "Ns"))
+      parseFloat(s + 2, eol, &m->shininess);
+    else if (keyword(s, eol, "d"))
+      parseFloat(s + 1, eol, &m->opacity);
+    else if (keyword(s, eol, "Tr")) {
+      float tr;
+      if (parseFloat(s + 2, eol, &tr))
+        m->opacity = 1.0f - tr;
+    } else if (keyword(s, eol, "map_Kd")) {
+      s = lastToken(s + 6, eol, &len);
+      copyName(m->texture, s, len);
+    }
+  }
+  if (mapped)
+    munmap((void *)data, size);
+  return 1;
+}
@@ -0,0 +1,51 @@
+/*!\file objloader.h
+ *
+ * \brief chargeur OBJ/MTL rapide et parallèle, utilisé à la place
+ * d'Assimp pour les fichiers .obj.
+ * \author Lucien Cartier
+ */
+
+#ifndef _OBJLOADER_H
+
+#define _OBJLOADER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OBJ_NAME_MAX 256
+
+  typedef struct objMaterial objMaterial;
+  struct objMaterial {
+    char name[OBJ_NAME_MAX], texture[OBJ_NAME_MAX]; /* texture : map_Kd */
+    float ambient[4], diffuse[4], specular[4], emission[4];
+    float shininess, opacity;
+  };
+
+  /* un maillage par groupe usemtl ; vertices contient les positions, puis
+   * les normales, puis les coordonnées de texture (disposition envoyée par
+   * sceneMkVAOs) */
+  typedef struct objMesh objMesh;
+  struct objMesh {
+    float *vertices;
+    unsigned int *indices;
+    unsigned int nbVertices, count, material;
+    int hasNormals, hasTexCoords;
+  };
+
+  typedef struct objScene objScene;
+  struct objScene {
+    objMesh *meshes;
+    objMaterial *materials;
+    unsigned int nbMeshes, nbMaterials;
+    float min[3], max[3];
+  };
+
+  extern objScene *objLoad(const char *filename, int nbThreads);
+  extern void objFree(objScene *scene);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,199 @@
+/*!\file pack.c
+ *
+ * \brief lecture de l'archive des ressources.
+ *
+ * L'archive est projetée d'un bloc (mmap) et lue d'avance ; l'en-tête et
+ * la table sont vérifiés à l'ouverture, chaque ressource lors de son
+ * premier accès. Les ressources sont servies sans copie : pointeur dans la
+ * projection, SDL_RWops en lecture seule (packrw.c) ou source de shader
+ * pour gl4duCreateProgram. Sans archive, ou pour un nom absent ou
+ * corrompu, on retombe sur le fichier du même nom.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "pack.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static const packEntry *lookup(const char *name);
+
+static const unsigned char *_data = NULL;
+static size_t _size = 0;
+static const packHeader *_header = NULL;
+static const packEntry *_table = NULL;
+/* ressources dont la somme de contrôle a été vérifiée */
+static unsigned char *_checked = NULL;
+
+uint32_t packSlots(uint32_t nbEntries) {
+  uint32_t n = 16;
+  while (n < 2 * nbEntries)
+    n *= 2;
+  return n;
+}
+
+/* FNV-1a 64 bits */
+uint64_t packHash(const char *name) {
+  uint64_t h = FNV_OFFSET;
+  while (*name) {
+    h ^= (unsigned char)*name++;
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+/* FNV-1a par mots de 64 bits, puis octet par octet pour la fin : huit fois
+ * moins de multiplications que la version octet par octet */
+uint64_t packChecksum(const void *data, size_t size) {
+  const unsigned char *p = data;
+  uint64_t h = FNV_OFFSET ^ size, w;
+  for (; size >= sizeof w; size -= sizeof w, p += sizeof w) {
+    memcpy(&w, p, sizeof w);
+    h = (h ^ w) * FNV_PRIME;
+  }
+  for (; size; --size)
+    h = (h ^ *p++) * FNV_PRIME;
+  return h;
+}
+
+/* renvoie 0 si l'archive est absente ou invalide : les ressources sont
+ * alors lues depuis leurs fichiers */
+int packInit(const char *filename) {
+  struct stat st;
+  const packHeader *hd;
+  void *p;
+  uint32_t i, nbNames = 0;
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "packInit: pas d'archive %s, lecture des fichiers\n",
+            filename);
+    return 0;
+  }
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof *hd) {
+    close(fd);
+    fprintf(stderr, "packInit: %s n'est pas une archive\n", filename);
+    return 0;
+  }
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "packInit: impossible de projeter %s\n", filename);
+    return 0;
+  }
+  /* toutes les ressources servent au démarrage : une seule lecture */
+  madvise(p, st.st_size, MADV_WILLNEED);
+  hd = p;
+  if (memcmp(hd->magic, PACK_MAGIC, sizeof hd->magic) ||
+      hd->size != (uint64_t)st.st_size || !hd->nbSlots ||
+      (hd->nbSlots & (hd->nbSlots - 1)) ||
+      /* table au plus à moitié pleine : toute recherche s'arrête */
+      (uint64_t)2 * hd->nbEntries > hd->nbSlots ||
+      sizeof *hd + (uint64_t)hd->nbSlots * sizeof *_table > hd->size ||
+      packChecksum(hd + 1, hd->nbSlots * sizeof *_table) !=
+          hd->tableChecksum)
+    goto corrupt;
+  for (i = 0; i < hd->nbSlots; ++i) {
+    const packEntry *e = &((const packEntry *)(hd + 1))[i];
+    if (!e->name[0])
+      continue;
+    if (e->name[PACK_NAME_MAX - 1] || e->hash != packHash(e->name) ||
+        e->offset % PACK_ALIGN || e->offset > hd->size ||
+        e->size >= hd->size - e->offset)
+      goto corrupt;
+    nbNames++;
+  }
+  if (nbNames != hd->nbEntries)
+    goto corrupt;
+  _data = p;
+  _size = st.st_size;
+  _header = hd;
+  _table = (const packEntry *)(hd + 1);
+  _checked = calloc(hd->nbSlots, sizeof *_checked);
+  assert(_checked);
+  fprintf(stderr, "packInit: %s, %u ressources\n", filename,
+          (unsigned int)hd->nbEntries);
+  return 1;
+corrupt:
+  fprintf(stderr, "packInit: archive %s corrompue, lecture des fichiers\n",
+          filename);
+  munmap(p, st.st_size);
+  return 0;
+}
+
+/* pointeur dans la projection, valide jusqu'à packQuit, suivi d'un octet
+ * nul ; NULL si la ressource n'est pas dans l'archive */
+const void *packData(const char *name, size_t *size) {
+  const packEntry *e = lookup(name);
+  const unsigned char *d;
+  if (!e)
+    return NULL;
+  d = _data + e->offset;
+  if (!_checked[e - _table]) {
+    if (packChecksum(d, e->size) != e->checksum) {
+      fprintf(stderr, "packData: %s corrompu dans l'archive\n", name);
+      return NULL;
+    }
+    _checked[e - _table] = 1;
+  }
+  *size = e->size;
+  return d;
+}
+
+/* argument de gl4duCreateProgram pour un shader de type "vs", "fs", ... :
+ * source en mémoire si elle est dans l'archive, fichier sinon ; à libérer
+ * par l'appelant */
+char *packShader(const char *type, const char *name) {
+  size_t size, len;
+  const char *d = packData(name, &size);
+  char *arg;
+  if (!d) {
+    len = strlen(type) + strlen(name) + 3;
+    arg = malloc(len);
+    assert(arg);
+    snprintf(arg, len, "<%s>%s", type, name);
+    return arg;
+  }
+  len = 2 * strlen(type) + strlen(name) + size + 10;
+  arg = malloc(len);
+  assert(arg);
+  snprintf(arg, len, "<im%s>%s</im%s>%s", type, name, type, d);
+  return arg;
+}
+
+/* à appeler une fois les ressources servies libérées (musique comprise,
+ * lue au fil de l'eau) */
+void packQuit(void) {
+  if (!_data)
+    return;
+  munmap((void *)_data, _size);
+  _data = NULL;
+  _size = 0;
+  _header = NULL;
+  _table = NULL;
+  free(_checked);
+  _checked = NULL;
+}
+
+static const packEntry *lookup(const char *name) {
+  uint32_t mask, i;
+  uint64_t h;
+  if (!_data)
+    return NULL;
+  while (!strncmp(name, "./", 2))
+    name += 2;
+  h = packHash(name);
+  mask = _header->nbSlots - 1;
+  for (i = h & mask; _table[i].name[0]; i = (i + 1) & mask)
+    if (_table[i].hash == h && !strcmp(_table[i].name, name))
+      return &_table[i];
+  return NULL;
+}
@@ -0,0 +1,61 @@
+/*!\file pack.h
+ *
+ * \brief archive unique des ressources (modèle, textures, police, shaders,
+ * musique), projetée en mémoire une seule fois au démarrage.
+ *
+ * Format, dans l'ordre des octets de la machine qui l'a produit : un
+ * en-tête, une table de hachage (adressage ouvert, sondage linéaire) de
+ * packSlots(n) entrées, puis les données, chacune alignée sur PACK_ALIGN
+ * et suivie d'un octet nul. Les noms sont hachés en FNV-1a 64 bits ; la
+ * table et chaque ressource portent une somme de contrôle.
+ *
+ * Seul packRW, défini à part dans packrw.c, dépend de SDL : l'outil
+ * d'empaquetage n'a besoin que de pack.c.
+ * \author Lucien Cartier
+ */
+
+#ifndef _PACK_H
+
+#define _PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PACK_MAGIC "SQPACK01"
+#define PACK_ALIGN 64
+#define PACK_NAME_MAX 104
+
+  typedef struct packHeader packHeader;
+  struct packHeader {
+    char magic[8];
+    uint32_t nbEntries, nbSlots;
+    uint64_t tableChecksum, size; /* size : taille totale de l'archive */
+  };
+
+  /* entrée vide : name[0] nul */
+  typedef struct packEntry packEntry;
+  struct packEntry {
+    uint64_t hash, offset, size, checksum;
+    char name[PACK_NAME_MAX];
+  };
+
+  extern uint32_t packSlots(uint32_t nbEntries);
+  extern uint64_t packHash(const char *name);
+  extern uint64_t packChecksum(const void *data, size_t size);
+
+  extern int packInit(const char *filename);
+  extern const void *packData(const char *name, size_t *size);
+  struct SDL_RWops;
+  extern struct SDL_RWops *packRW(const char *name);
+  extern char *packShader(const char *type, const char *name);
+  extern void packQuit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+/*!\file packer.c
+ *
+ * \brief construction de l'archive des ressources lue par pack.c.
+ *
+ * Usage : ALYS_squares_pack archive fichier... ; chaque fichier est rangé
+ * sous son chemin tel que donné (relatif au dossier du programme), c'est
+ * le nom sous lequel le programme le demande.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "pack.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *readFile(const char *filename, size_t *size);
+static uint64_t align(uint64_t offset);
+
+int main(int argc, char **argv) {
+  static const char zeros[PACK_ALIGN] = {0};
+  packHeader hd;
+  packEntry *table;
+  void **data;
+  uint64_t offset;
+  uint32_t i, j, nbEntries = argc > 2 ? argc - 2 : 0;
+  FILE *f;
+
+  if (!nbEntries) {
+    fprintf(stderr, "Usage : %s archive fichier...\n", argv[0]);
+    return 1;
+  }
+  memset(&hd, 0, sizeof hd);
+  memcpy(hd.magic, PACK_MAGIC, sizeof hd.magic);
+  hd.nbEntries = nbEntries;
+  hd.nbSlots = packSlots(nbEntries);
+  table = calloc(hd.nbSlots, sizeof *table);
+  data = calloc(nbEntries, sizeof *data);
+  assert(table && data);
+
+  /* données à la suite de la table, chacune alignée et suivie d'un nul */
+  offset = align(sizeof hd + (uint64_t)hd.nbSlots * sizeof *table);
+  for (i = 0; i < nbEntries; ++i) {
+    const char *name = argv[i + 2];
+    uint64_t h = packHash(name);
+    size_t size;
+    if (strlen(name) >= PACK_NAME_MAX) {
+      fprintf(stderr, "%s : nom trop long\n", name);
+      return 2;
+    }
+    if (!(data[i] = readFile(name, &size))) {
+      fprintf(stderr, "%s : lecture impossible\n", name);
+      return 2;
+    }
+    for (j = h & (hd.nbSlots - 1); table[j].name[0];
+         j = (j + 1) & (hd.nbSlots - 1))
+      if (!strcmp(table[j].name, name)) {
+        fprintf(stderr, "%s : donné deux fois\n", name);
+        return 2;
+      }
+    table[j].hash = h;
+    table[j].offset = offset;
+    table[j].size = size;
+    table[j].checksum = packChecksum(data[i], size);
+    strcpy(table[j].name, name);
+    offset = align(offset + size + 1);
+  }
+  hd.size = offset;
+  hd.tableChecksum = packChecksum(table, hd.nbSlots * sizeof *table);
+
+  if (!(f = fopen(argv[1], "wb"))) {
+    fprintf(stderr, "%s : écriture impossible\n", argv[1]);
+    return 3;
+  }
+  fwrite(&hd, sizeof hd, 1, f);
+  fwrite(table, sizeof *table, hd.nbSlots, f);
+  /* dans l'ordre de la ligne de commande, qui est celui des offsets */
+  for (i = 0; i < nbEntries; ++i) {
+    const packEntry *e;
+    for (j = packHash(argv[i + 2]) & (hd.nbSlots - 1);
+         strcmp(table[j].name, argv[i + 2]); j = (j + 1) & (hd.nbSlots - 1))
+      ;
+    e = &table[j];
+    fwrite(zeros, 1, e->offset - ftell(f), f);
+    fwrite(data[i], 1, e->size, f);
+    fwrite(zeros, 1, 1, f);
+    free(data[i]);
+  }
+  fwrite(zeros, 1, hd.size - ftell(f), f);
+  if (ferror(f) | fclose(f)) {
+    fprintf(stderr, "%s : écriture impossible\n", argv[1]);
+    remove(argv[1]);
+    return 3;
+  }
+  printf("%s : %u ressources, %lu octets\n", argv[1], (unsigned int)nbEntries,
+         (unsigned long)hd.size);
+  free(table);
+  free(data);
+  return 0;
+}
+
+static void *readFile(const char *filename, size_t *size) {
+  FILE *f = fopen(filename, "rb");
+  void *d;
+  long n;
+  if (!f)
+    return NULL;
+  if (fseek(f, 0, SEEK_END) || (n = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET)) {
+    fclose(f);
+    return NULL;
+  }
+  d = malloc(n + 1);
+  assert(d);
+  if (fread(d, 1, n, f) != (size_t)n) {
+    fclose(f);
+    free(d);
+    return NULL;
+  }
+  fclose(f);
+  *size = n;
+  return d;
+}
+
+static uint64_t align(uint64_t offset) {
+  return (offset + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN;
+}
@@ -0,0 +1,20 @@
+/*!\file packrw.c
+ *
+ * \brief flux SDL sur les ressources de l'archive, à part de pack.c pour
+ * que l'outil d'empaquetage ne dépende pas de SDL.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "pack.h"
+#include <SDL.h>
+
+/* flux en lecture seule sur la ressource, ou sur le fichier du même nom ;
+ * à fermer par l'appelant (ou par la bibliothèque à qui il est confié) */
+SDL_RWops *packRW(const char *name) {
+  size_t size;
+  const void *d = packData(name, &size);
+  if (d)
+    return SDL_RWFromConstMem(d, (int)size);
+  return SDL_RWFromFile(name, "rb");
+}
@@ -0,0 +1,513 @@
+/*!\file raster.c
+ *
+ * \brief rasteriseur logiciel par tuiles et multi-threadé.
+ *
+ * Les sommets sont transformés et les triangles découpés contre le plan
+ * near sur le thread appelant, puis rangés dans les tuiles qu'ils
+ * recouvrent. rasterFlush distribue ensuite les tuiles aux threads du
+ * pool : chaque tuile traite ses triangles dans l'ordre de soumission,
+ * le blending reste donc correct sans aucune synchronisation entre
+ * tuiles. Les fonctions d'arête sont évaluées 4 pixels à la fois (SSE2)
+ * et l'échantillonnage de texture est corrigé en perspective.
+ *
+ * Les matrices suivent la convention de GL4Dummies (lignes majeures,
+ * gl4duTranslatef & co multiplient à droite) ; les piles sont celles de
+ * mat4.c.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "raster.h"
+#include "mat4.h"
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define TILE_SIZE 64
+#define MAX_THREADS 64
+
+/* sommet en coordonnées de clipping */
+typedef struct cvertex_t cvertex_t;
+struct cvertex_t {
+  float p[4], s, t;
+};
+
+/* triangle prêt à être rasterisé : chaque grandeur est une équation de
+ * plan a * x + b * y + c en coordonnées écran */
+typedef struct rtriangle_t rtriangle_t;
+struct rtriangle_t {
+  float e[3][3];         /* coordonnées barycentriques */
+  float z[3], iw[3];     /* profondeur et 1/w */
+  float sw[3], tw[3];    /* s/w et t/w */
+  int x0, y0, x1, y1;    /* boîte englobante écran, x1 et y1 exclus */
+  const rasterTexture *tex;
+  int blend;
+};
+
+typedef struct rbin_t rbin_t;
+struct rbin_t {
+  unsigned int *tris;
+  int n, size;
+};
+
+static void emit(const cvertex_t *v0, const cvertex_t *v1,
+                 const cvertex_t *v2);
+static int clipNear(const cvertex_t *in, cvertex_t *out);
+static void bin(unsigned int itri);
+static void rasterTile(int itile);
+static void processTiles(void);
+static void *worker(void *arg);
+
+/* framebuffer */
+static int _w = 0, _h = 0, _dpitch = 0;
+static unsigned int *_color = NULL;
+static float *_depth = NULL;
+static unsigned int _clearColor = 0;
+static int _clearPending = 0;
+
+/* matrices et états */
+static unsigned int _stacks[2] = {0, 0};
+static int _bound = RASTER_MODELVIEW;
+static const rasterTexture *_tex = NULL;
+static int _blend = 0;
+
+/* triangles de la frame et tuiles */
+static rtriangle_t *_tris = NULL;
+static int _nbTris = 0, _sizeTris = 0;
+static rbin_t *_bins = NULL;
+static int _tilesX = 0, _tilesY = 0, _nbTiles = 0;
+
+/* pool de threads */
+static pthread_t _threads[MAX_THREADS];
+static int _nbWorkers = 0, _quit = 0, _pending = 0, _nextTile = 0;
+static unsigned int _generation = 0;
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _start = PTHREAD_COND_INITIALIZER,
+                      _done = PTHREAD_COND_INITIALIZER;
+
+int rasterInit(int w, int h, int nbThreads) {
+  int i;
+  assert(w > 0 && h > 0);
+  _w = w;
+  _h = h;
+  _dpitch = (w + 3) & ~3;
+  if (!(_color = malloc(_w * _h * sizeof *_color)) ||
+      !(_depth = malloc(_dpitch * _h * sizeof *_depth)))
+    return 0;
+  _tilesX = (_w + TILE_SIZE - 1) / TILE_SIZE;
+  _tilesY = (_h + TILE_SIZE - 1) / TILE_SIZE;
+  _nbTiles = _tilesX * _tilesY;
+  if (!(_bins = calloc(_nbTiles, sizeof *_bins)))
+    return 0;
+  for (i = 0; i < 2; ++i)
+    _stacks[i] = mat4GenStack();
+  rasterClear(0);
+  if (nbThreads <= 0)
+    nbThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  nbThreads = nbThreads < 1 ? 1 : (nbThreads > MAX_THREADS ? MAX_THREADS
+                                                            : nbThreads);
+  /* le thread appelant participe aussi au rendu des tuiles */
+  _quit = 0;
+  for (_nbWorkers = 0; _nbWorkers < nbThreads - 1; ++_nbWorkers)
+    if (pthread_create(&_threads[_nbWorkers], NULL, worker, NULL))
+      break;
+  return 1;
+}
+
+void rasterClear(unsigned int color) {
+  _clearColor = color;
+  _clearPending = 1;
+}
+
+void rasterBindMatrix(int matrix) {
+  assert(matrix == RASTER_MODELVIEW || matrix == RASTER_PROJECTION);
+  _bound = matrix;
+}
+
+void rasterLoadIdentity(void) { mat4LoadIdentity(_stacks[_bound]); }
+
+void rasterPushMatrix(void) { mat4Push(_stacks[_bound]); }
+
+void rasterPopMatrix(void) { mat4Pop(_stacks[_bound]); }
+
+void rasterMultMatrix(const float *m) { mat4Mult(_stacks[_bound], m); }
+
+void rasterTranslate(float x, float y, float z) {
+  mat4Translate(_stacks[_bound], x, y, z);
+}
+
+void rasterRotate(float angle, float x, float y, float z) {
+  mat4Rotate(_stacks[_bound], angle, x, y, z);
+}
+
+void rasterScale(float x, float y, float z) {
+  mat4Scale(_stacks[_bound], x, y, z);
+}
+
+void rasterFrustum(float l, float r, float b, float t, float n, float f) {
+  mat4Frustum(_stacks[_bound], l, r, b, t, n, f);
+}
+
+void rasterBlend(int enable) { _blend = enable; }
+
+void rasterBindTexture(const rasterTexture *tex) { _tex = tex; }
+
+/* même échantillonnage que shaders/model.vs et model.fs :
+ * texture(tex, -vec2(s, 1 - t)) */
+void rasterDrawElements(const float *positions, const float *texCoords,
+                        int nbVertices, const unsigned int *indices,
+                        int count) {
+  int i, j, k, n;
+  float mvp[16];
+  cvertex_t *cv, tri[3], poly[4];
+  mat4Multiply(mvp, mat4Top(_stacks[RASTER_PROJECTION]),
+               mat4Top(_stacks[RASTER_MODELVIEW]));
+  cv = malloc(nbVertices * sizeof *cv);
+  assert(cv);
+  for (i = 0; i < nbVertices; ++i) {
+    const float *p = &positions[3 * i];
+    for (j = 0; j < 4; ++j)
+      cv[i].p[j] = mvp[4 * j] * p[0] + mvp[4 * j + 1] * p[1] +
+                   mvp[4 * j + 2] * p[2] + mvp[4 * j + 3];
+    cv[i].s = texCoords ? -texCoords[2 * i] : 0.0f;
+    cv[i].t = texCoords ? texCoords[2 * i + 1] - 1.0f : 0.0f;
+  }
+  for (i = 0; i + 2 < count; i += 3) {
+    for (j = 0; j < 3; ++j)
+      tri[j] = cv[indices[i + j]];
+    n = clipNear(tri, poly);
+    for (k = 1; k + 1 < n; ++k)
+      emit(&poly[0], &poly[k], &poly[k + 1]);
+  }
+  free(cv);
+}
+
+void rasterDrawCube(void) {
+  /* cube [-1, 1]^3, faces CCW vues de l'extérieur, comme gl4dgGenCubef */
+  static const float p[] = {
+      -1, -1, 1,  1,  -1, 1,  1,  1,  1,  -1, 1,  1,  /* +z */
+      1,  -1, -1, -1, -1, -1, -1, 1,  -1, 1,  1,  -1, /* -z */
+      1,  -1, 1,  1,  -1, -1, 1,  1,  -1, 1,  1,  1,  /* +x */
+      -1, -1, -1, -1, -1, 1,  -1, 1,  1,  -1, 1,  -1, /* -x */
+      -1, 1,  1,  1,  1,  1,  1,  1,  -1, -1, 1,  -1, /* +y */
+      -1, -1, -1, 1,  -1, -1, 1,  -1, 1,  -1, -1, 1   /* -y */
+  };
+  static const float uv[] = {0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1,
+                             0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1,
+                             0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1};
+  static const unsigned int idx[] = {
+      0,  1,  2,  0,  2,  3,  4,  5,  6,  4,  6,  7,  8,  9,  10, 8,  10, 11,
+      12, 13, 14, 12, 14, 15, 16, 17, 18, 16, 18, 19, 20, 21, 22, 20, 22, 23};
+  rasterDrawElements(p, uv, 24, idx, 36);
+}
+
+void rasterFlush(void) {
+  int i;
+  __atomic_store_n(&_nextTile, 0, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&_mutex);
+  _pending = _nbWorkers;
+  _generation++;
+  pthread_cond_broadcast(&_start);
+  pthread_mutex_unlock(&_mutex);
+  processTiles();
+  pthread_mutex_lock(&_mutex);
+  while (_pending)
+    pthread_cond_wait(&_done, &_mutex);
+  pthread_mutex_unlock(&_mutex);
+  for (i = 0; i < _nbTiles; ++i)
+    _bins[i].n = 0;
+  _nbTris = 0;
+  _clearPending = 0;
+}
+
+unsigned int *rasterGetPixels(int *w, int *h) {
+  if (w)
+    *w = _w;
+  if (h)
+    *h = _h;
+  return _color;
+}
+
+/* export PPM (P6), la ligne 0 du framebuffer étant le bas de l'image */
+int rasterExport(const char *filename) {
+  int x, y;
+  unsigned char *row;
+  FILE *f = fopen(filename, "wb");
+  if (!f) {
+    fprintf(stderr, "can't open file %s\n", filename);
+    return 0;
+  }
+  row = malloc(3 * _w);
+  assert(row);
+  fprintf(f, "P6\n%d %d\n255\n", _w, _h);
+  for (y = _h - 1; y >= 0; --y) {
+    const unsigned int *c = &_color[y * _w];
+    for (x = 0; x < _w; ++x) {
+      row[3 * x] = c[x] & 0xFF;
+      row[3 * x + 1] = (c[x] >> 8) & 0xFF;
+      row[3 * x + 2] = (c[x] >> 16) & 0xFF;
+    }
+    fwrite(row, 3, _w, f);
+  }
+  free(row);
+  return fclose(f) == 0;
+}
+
+void rasterQuit(void) {
+  int i;
+  pthread_mutex_lock(&_mutex);
+  _quit = 1;
+  pthread_cond_broadcast(&_start);
+  pthread_mutex_unlock(&_mutex);
+  for (i = 0; i < _nbWorkers; ++i)
+    pthread_join(_threads[i], NULL);
+  _nbWorkers = 0;
+  if (_bins) {
+    for (i = 0; i < _nbTiles; ++i)
+      free(_bins[i].tris);
+    free(_bins);
+    _bins = NULL;
+  }
+  free(_tris);
+  _tris = NULL;
+  _nbTris = _sizeTris = 0;
+  free(_color);
+  _color = NULL;
+  free(_depth);
+  _depth = NULL;
+  for (i = 0; i < 2; ++i)
+    if (_stacks[i]) {
+      mat4DeleteStack(_stacks[i]);
+      _stacks[i] = 0;
+    }
+}
+
+/* Sutherland-Hodgman contre le plan near (z + w >= 0), renvoie le nombre
+ * de sommets du polygone résultant (0, 3 ou 4) */
+static int clipNear(const cvertex_t *in, cvertex_t *out) {
+  int i, n = 0;
+  for (i = 0; i < 3; ++i) {
+    const cvertex_t *a = &in[i], *b = &in[(i + 1) % 3];
+    float da = a->p[2] + a->p[3], db = b->p[2] + b->p[3];
+    if (da >= 0.0f)
+      out[n++] = *a;
+    if ((da >= 0.0f) != (db >= 0.0f)) {
+      float r = da / (da - db);
+      int j;
+      for (j = 0; j < 4; ++j)
+        out[n].p[j] = a->p[j] + r * (b->p[j] - a->p[j]);
+      out[n].s = a->s + r * (b->s - a->s);
+      out[n].t = a->t + r * (b->t - a->t);
+      n++;
+    }
+  }
+  return n;
+}
+
+static void emit(const cvertex_t *v0, const cvertex_t *v1,
+                 const cvertex_t *v2) {
+  const cvertex_t *v[3] = {v0, v1, v2};
+  float x[3], y[3], z[3], iw[3], area2, ia;
+  rtriangle_t *t;
+  int i;
+  for (i = 0; i < 3; ++i) {
+    iw[i] = 1.0f / v[i]->p[3];
+    x[i] = (v[i]->p[0] * iw[i] * 0.5f + 0.5f) * _w;
+    y[i] = (v[i]->p[1] * iw[i] * 0.5f + 0.5f) * _h;
+    z[i] = v[i]->p[2] * iw[i] * 0.5f + 0.5f;
+  }
+  /* culling des faces arrières (CCW = face avant, y vers le haut) */
+  area2 = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+  if (!(area2 > 0.0f))
+    return;
+  if (_nbTris == _sizeTris) {
+    _sizeTris = _sizeTris ? 2 * _sizeTris : 4096;
+    _tris = realloc(_tris, _sizeTris * sizeof *_tris);
+    assert(_tris);
+  }
+  t = &_tris[_nbTris];
+  ia = 1.0f / area2;
+  for (i = 0; i < 3; ++i) {
+    /* arête opposée au sommet i, de a vers b */
+    int a = (i + 1) % 3, b = (i + 2) % 3;
+    float dx = x[b] - x[a], dy = y[b] - y[a];
+    t->e[i][0] = -dy * ia;
+    t->e[i][1] = dx * ia;
+    t->e[i][2] = (dy * x[a] - dx * y[a]) * ia;
+    /* règle top-left : les arêtes droites et basses sont exclues */
+    if (!(dy < 0.0f || (dy == 0.0f && dx < 0.0f)))
+      t->e[i][2] -= (1.0f / 256.0f) * ia;
+  }
+  for (i = 0; i < 3; ++i) {
+    int k;
+    float *pl[4] = {t->z, t->iw, t->sw, t->tw};
+    const float a[4][3] = {{z[0], z[1], z[2]},
+                           {iw[0], iw[1], iw[2]},
+                           {v0->s * iw[0], v1->s * iw[1], v2->s * iw[2]},
+                           {v0->t * iw[0], v1->t * iw[1], v2->t * iw[2]}};
+    for (k = 0; k < 4; ++k)
+      pl[k][i] = a[k][0] * t->e[0][i] + a[k][1] * t->e[1][i] +
+                 a[k][2] * t->e[2][i];
+  }
+  t->x0 = (int)floorf(fminf(x[0], fminf(x[1], x[2])));
+  t->y0 = (int)floorf(fminf(y[0], fminf(y[1], y[2])));
+  t->x1 = (int)ceilf(fmaxf(x[0], fmaxf(x[1], x[2]))) + 1;
+  t->y1 = (int)ceilf(fmaxf(y[0], fmaxf(y[1], y[2]))) + 1;
+  t->x0 = t->x0 < 0 ? 0 : t->x0;
+  t->y0 = t->y0 < 0 ? 0 : t->y0;
+  t->x1 = t->x1 > _w ? _w : t->x1;
+  t->y1 = t->y1 > _h ? _h : t->y1;
+  if (t->x0 >= t->x1 || t->y0 >= t->y1)
+    return;
+  t->tex = _tex;
+  t->blend = _blend;
+  bin(_nbTris++);
+}
+
+static void bin(unsigned int itri) {
+  const rtriangle_t *t = &_tris[itri];
+  int tx, ty;
+  for (ty = t->y0 / TILE_SIZE; ty <= (t->y1 - 1) / TILE_SIZE; ++ty)
+    for (tx = t->x0 / TILE_SIZE; tx <= (t->x1 - 1) / TILE_SIZE; ++tx) {
+      rbin_t *b = &_bins[ty * _tilesX + tx];
+      if (b->n == b->size) {
+        b->size = b->size ? 2 * b->size : 64;
+        b->tris = realloc(b->tris, b->size * sizeof *b->tris);
+        assert(b->tris);
+      }
+      b->tris[b->n++] = itri;
+    }
+}
+
+static inline void shade(const rtriangle_t *t, int idx, int didx, float z,
+                         float s, float tc) {
+  unsigned int c = 0xFFFFFFFF, *dst = &_color[idx];
+  if (t->tex) {
+    const rasterTexture *tx = t->tex;
+    int u = (int)((s - floorf(s)) * tx->w), v = (int)((tc - floorf(tc)) * tx->h);
+    u = u >= tx->w ? tx->w - 1 : u;
+    v = v >= tx->h ? tx->h - 1 : v;
+    c = tx->texels[v * tx->pitch + u];
+  }
+  if (t->blend) {
+    unsigned int a = c >> 24, ia = 255 - a, d = *dst, r, g, b;
+    r = ((c & 0xFF) * a + (d & 0xFF) * ia) / 255;
+    g = (((c >> 8) & 0xFF) * a + ((d >> 8) & 0xFF) * ia) / 255;
+    b = (((c >> 16) & 0xFF) * a + ((d >> 16) & 0xFF) * ia) / 255;
+    c = r | (g << 8) | (b << 16) | (d & 0xFF000000);
+  }
+  *dst = c;
+  _depth[didx] = z;
+}
+
+static void rasterTile(int itile) {
+  int tx = itile % _tilesX, ty = itile / _tilesX, x, y, i;
+  int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+  int x1 = x0 + TILE_SIZE > _w ? _w : x0 + TILE_SIZE;
+  int y1 = y0 + TILE_SIZE > _h ? _h : y0 + TILE_SIZE;
+  const rbin_t *b = &_bins[itile];
+  if (_clearPending)
+    for (y = y0; y < y1; ++y) {
+      for (x = x0; x < x1; ++x)
+        _color[y * _w + x] = _clearColor;
+      for (x = x0; x < (x1 == _w ? _dpitch : x1); ++x)
+        _depth[y * _dpitch + x] = 1.0f;
+    }
+  for (i = 0; i < b->n; ++i) {
+    const rtriangle_t *t = &_tris[b->tris[i]];
+    /* x de départ aligné sur 4 : le début d'une tuile l'est toujours */
+    int bx0 = (t->x0 > x0 ? t->x0 : x0) & ~3, bx1 = t->x1 < x1 ? t->x1 : x1;
+    int by0 = t->y0 > y0 ? t->y0 : y0, by1 = t->y1 < y1 ? t->y1 : y1;
+#ifdef __SSE2__
+    const __m128 offs = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f),
+                 four = _mm_set1_ps(4.0f), zero = _mm_setzero_ps(),
+                 xmax = _mm_set1_ps((float)bx1);
+#define PLANE(p, vx, py)                                                       \
+  _mm_add_ps(_mm_mul_ps(_mm_set1_ps((p)[0]), vx),                              \
+             _mm_set1_ps((p)[1] * (py) + (p)[2]))
+    for (y = by0; y < by1; ++y) {
+      float py = y + 0.5f;
+      __m128 vx = _mm_add_ps(_mm_set1_ps((float)bx0), offs);
+      for (x = bx0; x < bx1; x += 4, vx = _mm_add_ps(vx, four)) {
+        __m128 l0 = PLANE(t->e[0], vx, py);
+        __m128 l1 = PLANE(t->e[1], vx, py);
+        __m128 l2 = PLANE(t->e[2], vx, py);
+        __m128 m = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(l0, zero),
+                                         _mm_cmpge_ps(l1, zero)),
+                              _mm_and_ps(_mm_cmpge_ps(l2, zero),
+                                         _mm_cmplt_ps(vx, xmax)));
+        __m128 vz, iw, s, tc;
+        float fz[4], fs[4], ft[4];
+        int bits, k, didx = y * _dpitch + x;
+        if (!_mm_movemask_ps(m))
+          continue;
+        vz = PLANE(t->z, vx, py);
+        m = _mm_and_ps(m, _mm_cmplt_ps(vz, _mm_loadu_ps(&_depth[didx])));
+        if (!(bits = _mm_movemask_ps(m)))
+          continue;
+        iw = _mm_div_ps(_mm_set1_ps(1.0f), PLANE(t->iw, vx, py));
+        s = _mm_mul_ps(PLANE(t->sw, vx, py), iw);
+        tc = _mm_mul_ps(PLANE(t->tw, vx, py), iw);
+        _mm_storeu_ps(fz, vz);
+        _mm_storeu_ps(fs, s);
+        _mm_storeu_ps(ft, tc);
+        for (k = 0; k < 4; ++k)
+          if (bits & (1 << k))
+            shade(t, y * _w + x + k, didx + k, fz[k], fs[k], ft[k]);
+      }
+    }
+#undef PLANE
+#else
+    for (y = by0; y < by1; ++y) {
+      float py = y + 0.5f;
+      for (x = bx0; x < bx1; ++x) {
+        float px = x + 0.5f, z, w;
+        int didx = y * _dpitch + x;
+#define PLANE(p) ((p)[0] * px + (p)[1] * py + (p)[2])
+        if (PLANE(t->e[0]) < 0.0f || PLANE(t->e[1]) < 0.0f ||
+            PLANE(t->e[2]) < 0.0f)
+          continue;
+        if (!((z = PLANE(t->z)) < _depth[didx]))
+          continue;
+        w = 1.0f / PLANE(t->iw);
+        shade(t, y * _w + x, didx, z, PLANE(t->sw) * w, PLANE(t->tw) * w);
+#undef PLANE
+      }
+    }
+#endif
+  }
+}
+
+static void processTiles(void) {
+  int i;
+  while ((i = __atomic_fetch_add(&_nextTile, 1, __ATOMIC_RELAXED)) < _nbTiles)
+    if (_clearPending || _bins[i].n)
+      rasterTile(i);
+}
+
+static void *worker(void *arg) {
+  unsigned int seen = 0;
+  (void)arg;
+  pthread_mutex_lock(&_mutex);
+  for (;;) {
+    while (!_quit && _generation == seen)
+      pthread_cond_wait(&_start, &_mutex);
+    if (_quit)
+      break;
+    seen = _generation;
+    pthread_mutex_unlock(&_mutex);
+    processTiles();
+    pthread_mutex_lock(&_mutex);
+    if (--_pending == 0)
+      pthread_cond_signal(&_done);
+  }
+  pthread_mutex_unlock(&_mutex);
+  return NULL;
+}
@@ -0,0 +1,56 @@
+/*!\file raster.h
+ *
+ * \brief rasteriseur logiciel par tuiles et multi-threadé, utilisé
+ * comme backend CPU (avec ou sans contexte OpenGL).
+ * \author Lucien Cartier
+ */
+
+#ifndef _RASTER_H
+
+#define _RASTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  enum {
+    RASTER_MODELVIEW = 0,
+    RASTER_PROJECTION
+  };
+
+  /* texture RGBA 8 bits par composante (R dans l'octet de poids faible),
+   * la première ligne correspond à t = 0 comme avec glTexImage2D */
+  typedef struct rasterTexture rasterTexture;
+  struct rasterTexture {
+    int w, h, pitch; /* pitch en pixels */
+    const unsigned int *texels;
+  };
+
+  extern int rasterInit(int w, int h, int nbThreads);
+  extern void rasterClear(unsigned int color);
+  extern void rasterBindMatrix(int matrix);
+  extern void rasterLoadIdentity(void);
+  extern void rasterPushMatrix(void);
+  extern void rasterPopMatrix(void);
+  extern void rasterMultMatrix(const float *m);
+  extern void rasterTranslate(float x, float y, float z);
+  extern void rasterRotate(float angle, float x, float y, float z);
+  extern void rasterScale(float x, float y, float z);
+  extern void rasterFrustum(float l, float r, float b, float t, float n,
+                            float f);
+  extern void rasterBlend(int enable);
+  extern void rasterBindTexture(const rasterTexture *tex);
+  extern void rasterDrawElements(const float *positions,
+                                 const float *texCoords, int nbVertices,
+                                 const unsigned int *indices, int count);
+  extern void rasterDrawCube(void);
+  extern void rasterFlush(void);
+  extern unsigned int *rasterGetPixels(int *w, int *h);
+  extern int rasterExport(const char *filename);
+  extern void rasterQuit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
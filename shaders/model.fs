@@ -1,6 +1,9 @@
 #version 330
 
 uniform sampler2D tex;
+/* 0 : pas de test alpha (matériaux opaques et translucides) */
+uniform float alphaTest;
+uniform float opacity;
 in vec2 vsoTexCoord;
 in vec3 vsoNormal;
 in vec4 vsoModPosition;
@@ -9,4 +12,7 @@ out vec4 fragColor;
 
 void main(void) {
   fragColor = texture(tex, -vsoTexCoord);
+  if (fragColor.a < alphaTest)
+    discard;
+  fragColor.a *= opacity;
 }
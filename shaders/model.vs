@@ -1,7 +1,11 @@
 #version 330
 
-uniform mat4 modelViewMatrix;
-uniform mat4 projectionMatrix;
+/* matrices calculées une fois par objet côté CPU (ubo.c) */
+layout(std140, row_major) uniform objectMatrices {
+  mat4 modelViewMatrix;
+  mat4 mvpMatrix;
+  mat4 normalMatrix;
+};
 
 layout(location = 0) in vec3 vsiPosition;
 layout(location = 1) in vec3 vsiNormal;
@@ -12,9 +16,8 @@ out vec3 vsoNormal;
 out vec4 vsoModPosition;
 
 void main(void) {
-  vsoNormal =
-    (transpose(inverse(modelViewMatrix)) * vec4(vsiNormal.xyz, 0.0)).xyz;
+  vsoNormal = (normalMatrix * vec4(vsiNormal.xyz, 0.0)).xyz;
   vsoModPosition = modelViewMatrix * vec4(vsiPosition.xyz, 1.0);
-  gl_Position = projectionMatrix * modelViewMatrix * vec4(vsiPosition.xyz, 1.0);
+  gl_Position = mvpMatrix * vec4(vsiPosition.xyz, 1.0);
   vsoTexCoord = vec2(vsiTexCoord.x, 1.0 - vsiTexCoord.y);
 }
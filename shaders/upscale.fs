@@ -0,0 +1,23 @@
+#version 330
+
+/* agrandissement bilinéaire de la sous-région rendue (texScale) suivi d'un
+ * renforcement de netteté borné par le voisinage pour éviter les halos */
+uniform sampler2D tex;
+uniform vec2 texScale;
+uniform float sharpness;
+in vec2 vsoTexCoord;
+out vec4 fragColor;
+
+void main(void) {
+  vec2 texel = 1.0 / vec2(textureSize(tex, 0));
+  vec2 uv = clamp(vsoTexCoord * texScale, 0.5 * texel, texScale - 0.5 * texel);
+  vec3 c = texture(tex, uv).rgb;
+  vec3 n = texture(tex, uv + vec2(0.0, texel.y)).rgb;
+  vec3 s = texture(tex, uv - vec2(0.0, texel.y)).rgb;
+  vec3 e = texture(tex, uv + vec2(texel.x, 0.0)).rgb;
+  vec3 w = texture(tex, uv - vec2(texel.x, 0.0)).rgb;
+  vec3 lo = min(c, min(min(n, s), min(e, w)));
+  vec3 hi = max(c, max(max(n, s), max(e, w)));
+  vec3 sharp = c + sharpness * (4.0 * c - n - s - e - w);
+  fragColor = vec4(clamp(sharp, lo, hi), 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330
+
+layout(location = 0) in vec3 vsiPosition;
+layout(location = 2) in vec2 vsiTexCoord;
+
+out vec2 vsoTexCoord;
+
+void main(void) {
+  gl_Position = vec4(vsiPosition.xy, 0.0, 1.0);
+  vsoTexCoord = vsiTexCoord;
+}
@@ -0,0 +1,200 @@
+/*!\file spectrum.c
+ *
+ * \brief historique du spectre sur le GPU.
+ *
+ * Le callback audio convertit chaque bloc en demi-flottants dans un
+ * anneau de transit protégé par un verrou (spectrumPush) ; le thread
+ * OpenGL y recopie les lignes en attente une fois par frame
+ * (spectrumUpload), seule opération faite sous le verrou : le callback
+ * n'attend jamais OpenGL. Un PBO orpheliné, à la taille de ces lignes, les
+ * reçoit ensuite, puis un seul glTexSubImage2D par suite de lignes
+ * contiguës dans la texture (deux au plus quand l'anneau reboucle) les
+ * copie. Si le rendu prend du retard, les lignes les plus anciennes sont
+ * perdues.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "spectrum.h"
+#include <GL4D/gl4du.h>
+#include <SDL.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPECTRUM_BINDING 1 /* 0 : matrices des objets (ubo.c) */
+#define SPECTRUM_UNIT 7    /* à l'écart des unités des autres passes */
+#define ROW_BYTES (SPECTRUM_BINS * sizeof(GLushort))
+
+static GLushort halfOf(float f);
+static void uploadRows(int first, int n, GLintptr offset);
+
+static GLuint _tex = 0, _pbo = 0, _ubo = 0;
+/* anneau de transit : _pending lignes à partir de _first */
+static GLushort *_staging = NULL;
+/* lignes retirées de l'anneau, propres au thread OpenGL */
+static GLushort *_rows = NULL;
+static int _first = 0, _pending = 0;
+static SDL_mutex *_mutex = NULL;
+/* dernière ligne écrite dans la texture */
+static int _row = SPECTRUM_ROWS - 1;
+
+void spectrumInit(void) {
+  GLint data[4] = {SPECTRUM_ROWS - 1, SPECTRUM_ROWS, 0, 0};
+  GLushort *zeros = calloc(SPECTRUM_ROWS * SPECTRUM_BINS, sizeof *zeros);
+  assert(zeros);
+  glGenTextures(1, &_tex);
+  glBindTexture(GL_TEXTURE_2D, _tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  /* anneau : l'échantillonnage reboucle en t */
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, SPECTRUM_BINS, SPECTRUM_ROWS, 0,
+               GL_RED, GL_HALF_FLOAT, zeros);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  free(zeros);
+  glGenBuffers(1, &_pbo);
+  glGenBuffers(1, &_ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof data, data, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, SPECTRUM_BINDING, _ubo);
+  _staging = malloc(SPECTRUM_ROWS * ROW_BYTES);
+  _rows = malloc(SPECTRUM_ROWS * ROW_BYTES);
+  assert(_staging && _rows);
+  _first = _pending = 0;
+  _row = SPECTRUM_ROWS - 1;
+  _mutex = SDL_CreateMutex();
+  assert(_mutex);
+}
+
+/* associe le bloc spectrumData et l'unité de la texture au programme */
+void spectrumProgram(unsigned int pId) {
+  GLuint index = glGetUniformBlockIndex(pId, "spectrumData");
+  GLint loc;
+  if (index != GL_INVALID_INDEX)
+    glUniformBlockBinding(pId, index, SPECTRUM_BINDING);
+  if ((loc = glGetUniformLocation(pId, "spectrum")) >= 0) {
+    glUseProgram(pId);
+    glUniform1i(loc, SPECTRUM_UNIT);
+    glUseProgram(0);
+  }
+}
+
+/* appelée depuis le callback audio : aucun appel OpenGL */
+void spectrumPush(const float *magnitudes, int n) {
+  GLushort *row;
+  int i;
+  if (!_mutex)
+    return;
+  n = n < SPECTRUM_BINS ? n : SPECTRUM_BINS;
+  SDL_LockMutex(_mutex);
+  if (_pending == SPECTRUM_ROWS) {
+    _first = (_first + 1) % SPECTRUM_ROWS;
+    _pending--;
+  }
+  row = &_staging[((_first + _pending) % SPECTRUM_ROWS) * SPECTRUM_BINS];
+  for (i = 0; i < n; ++i)
+    row[i] = halfOf(magnitudes[i]);
+  memset(row + n, 0, (SPECTRUM_BINS - n) * sizeof *row);
+  _pending++;
+  SDL_UnlockMutex(_mutex);
+}
+
+/* sur le thread OpenGL, une fois par frame */
+void spectrumUpload(void) {
+  int n, first, head;
+  GLint row;
+  /* d'autres passes ont pu changer la liaison ou l'unité : rétablies à
+   * chaque frame, qu'il y ait ou non de nouvelles lignes */
+  glBindBufferBase(GL_UNIFORM_BUFFER, SPECTRUM_BINDING, _ubo);
+  glActiveTexture(GL_TEXTURE0 + SPECTRUM_UNIT);
+  glBindTexture(GL_TEXTURE_2D, _tex);
+  glActiveTexture(GL_TEXTURE0);
+
+  SDL_LockMutex(_mutex);
+  n = _pending;
+  first = _first;
+  head = first + n <= SPECTRUM_ROWS ? n : SPECTRUM_ROWS - first;
+  memcpy(_rows, &_staging[first * SPECTRUM_BINS], head * ROW_BYTES);
+  if (head < n)
+    memcpy(&_rows[head * SPECTRUM_BINS], _staging, (n - head) * ROW_BYTES);
+  _first = (first + n) % SPECTRUM_ROWS;
+  _pending = 0;
+  SDL_UnlockMutex(_mutex);
+  if (!n)
+    return;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pbo);
+  /* nouveau stockage : pas d'attente sur les copies de la frame passée */
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, n * ROW_BYTES, _rows, GL_STREAM_DRAW);
+  glActiveTexture(GL_TEXTURE0 + SPECTRUM_UNIT);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  first = (_row + 1) % SPECTRUM_ROWS;
+  head = first + n <= SPECTRUM_ROWS ? n : SPECTRUM_ROWS - first;
+  uploadRows(first, head, 0);
+  if (head < n)
+    uploadRows(0, n - head, head * ROW_BYTES);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glActiveTexture(GL_TEXTURE0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  _row = (_row + n) % SPECTRUM_ROWS;
+
+  row = _row;
+  glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof row, &row);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/* après l'arrêt de l'audio : plus aucun spectrumPush en cours */
+void spectrumQuit(void) {
+  if (_mutex) {
+    SDL_DestroyMutex(_mutex);
+    _mutex = NULL;
+  }
+  free(_staging);
+  free(_rows);
+  _staging = _rows = NULL;
+  if (_tex) {
+    glDeleteTextures(1, &_tex);
+    _tex = 0;
+  }
+  if (_pbo) {
+    glDeleteBuffers(1, &_pbo);
+    glDeleteBuffers(1, &_ubo);
+    _pbo = _ubo = 0;
+  }
+}
+
+/* conversion tronquée vers un flottant 16 bits (IEEE 754 binary16) */
+static GLushort halfOf(float f) {
+  union {
+    float f;
+    unsigned int u;
+  } v;
+  unsigned int sign, e, m;
+  int he;
+  v.f = f;
+  sign = (v.u >> 16) & 0x8000;
+  e = (v.u >> 23) & 0xff;
+  m = v.u & 0x7fffff;
+  he = (int)e - 127 + 15;
+  if (e == 0xff)
+    return sign | 0x7c00 | (m ? 0x200 : 0);
+  if (he >= 0x1f)
+    return sign | 0x7c00;
+  if (he <= 0) {
+    /* dénormalisé, ou nul en dessous */
+    if (he < -10)
+      return sign;
+    return sign | ((m | 0x800000) >> (14 - he));
+  }
+  return sign | (he << 10) | (m >> 13);
+}
+
+/* n lignes depuis le PBO (à offset) vers la texture, à partir de first */
+static void uploadRows(int first, int n, GLintptr offset) {
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, SPECTRUM_BINS, n, GL_RED,
+                  GL_HALF_FLOAT, (const GLvoid *)offset);
+}
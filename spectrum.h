@@ -0,0 +1,38 @@
+/*!\file spectrum.h
+ *
+ * \brief historique du spectre sur le GPU : les amplitudes pondérées de
+ * chaque bloc analysé (kernelSpectrum, quart bas de la FFT d'un bloc de
+ * 1024 échantillons) deviennent une ligne d'une texture circulaire
+ * SPECTRUM_BINS x SPECTRUM_ROWS (R16F).
+ *
+ * Côté GLSL, après spectrumProgram :
+ *   uniform sampler2D spectrum;
+ *   layout(std140) uniform spectrumData { int spectrumRow, spectrumRows; };
+ * spectrumRow est la dernière ligne écrite ; la texture se répète en t,
+ * la ligne d'il y a k blocs est donc à t = (spectrumRow - k + 0.5) /
+ * spectrumRows.
+ * \author Lucien Cartier
+ */
+
+#ifndef _SPECTRUM_H
+
+#define _SPECTRUM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPECTRUM_BINS 256
+#define SPECTRUM_ROWS 256
+
+  extern void spectrumInit(void);
+  extern void spectrumProgram(unsigned int pId);
+  extern void spectrumPush(const float *magnitudes, int n);
+  extern void spectrumUpload(void);
+  extern void spectrumQuit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+/*!\file ubo.c
+ *
+ * \brief tampon uniforme par frame.
+ *
+ * Une uboFrame est remplie sans aucun appel OpenGL : uboBegin l'ouvre
+ * avec la matrice de projection, uboReserve y réserve des blocs
+ * objectMatrices que uboSet remplit (depuis plusieurs threads si besoin,
+ * chacun ses blocs). Sur le thread OpenGL, uboUpload orpheline le tampon
+ * et envoie la frame en une fois, puis uboBind attache le bloc d'un objet
+ * (glBindBufferRange) avant son dessin. Les matrices restent en lignes
+ * majeures : les shaders déclarent le bloc row_major.
+ *
+ * \author Lucien Cartier
+ */
+
+#include "ubo.h"
+#include "mat4.h"
+#include <GL4D/gl4du.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UBO_OBJECT_BINDING 0
+#define UBO_OBJECT_SIZE (3 * 16 * sizeof(GLfloat))
+#define UBO_INIT 64
+
+struct uboFrame {
+  unsigned char *data;
+  unsigned int count, size; /* en blocs */
+  GLfloat projection[16];
+};
+
+static GLuint _buffer = 0;
+static GLsizeiptr _gpuSize = 0; /* taille allouée côté GPU */
+static GLint _stride = 0;
+static unsigned int _uploaded = 0; /* blocs de la dernière frame envoyée */
+
+void uboInit(void) {
+  GLint align = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+  align = align > 0 ? align : 256;
+  /* chaque bloc commence sur un décalage accepté par glBindBufferRange */
+  _stride = (UBO_OBJECT_SIZE + align - 1) / align * align;
+  glGenBuffers(1, &_buffer);
+}
+
+/* associe le bloc objectMatrices du programme au point de liaison */
+void uboProgram(unsigned int pId) {
+  GLuint index = glGetUniformBlockIndex(pId, "objectMatrices");
+  if (index != GL_INVALID_INDEX)
+    glUniformBlockBinding(pId, index, UBO_OBJECT_BINDING);
+}
+
+/* à créer après uboInit, qui fixe l'écart entre deux blocs */
+uboFrame *uboFrameNew(void) {
+  uboFrame *f = calloc(1, sizeof *f);
+  assert(f && _stride);
+  f->size = UBO_INIT;
+  f->data = malloc(f->size * _stride);
+  assert(f->data);
+  return f;
+}
+
+void uboFrameFree(uboFrame *f) {
+  if (!f)
+    return;
+  free(f->data);
+  free(f);
+}
+
+void uboBegin(uboFrame *f, const float *projection) {
+  memcpy(f->projection, projection, sizeof f->projection);
+  f->count = 0;
+}
+
+/* renvoie le premier des n blocs ; peut agrandir la frame, donc à appeler
+ * avant que d'autres threads n'y écrivent */
+unsigned int uboReserve(uboFrame *f, unsigned int n) {
+  unsigned int first = f->count;
+  if (f->count + n > f->size) {
+    while (f->count + n > f->size)
+      f->size *= 2;
+    f->data = realloc(f->data, f->size * _stride);
+    assert(f->data);
+  }
+  f->count += n;
+  return first;
+}
+
+void uboSet(uboFrame *f, unsigned int object, const float *modelView) {
+  GLfloat *block = (GLfloat *)(f->data + object * _stride);
+  assert(object < f->count);
+  memcpy(block, modelView, 16 * sizeof *block);
+  mat4Multiply(block + 16, f->projection, modelView);
+  mat4NormalMatrix(block + 32, modelView);
+}
+
+unsigned int uboPush(uboFrame *f, const float *modelView) {
+  unsigned int object = uboReserve(f, 1);
+  uboSet(f, object, modelView);
+  return object;
+}
+
+void uboUpload(const uboFrame *f) {
+  GLsizeiptr bytes = (GLsizeiptr)f->count * _stride;
+  _uploaded = f->count;
+  if (!bytes)
+    return;
+  glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+  /* nouveau stockage à chaque frame : pas d'attente sur la précédente */
+  if (bytes > _gpuSize)
+    _gpuSize = (GLsizeiptr)f->size * _stride;
+  glBufferData(GL_UNIFORM_BUFFER, _gpuSize, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, bytes, f->data);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void uboBind(unsigned int object) {
+  assert(object < _uploaded);
+  glBindBufferRange(GL_UNIFORM_BUFFER, UBO_OBJECT_BINDING, _buffer,
+                    (GLintptr)object * _stride, UBO_OBJECT_SIZE);
+}
+
+void uboQuit(void) {
+  if (_buffer) {
+    glDeleteBuffers(1, &_buffer);
+    _buffer = 0;
+  }
+  _gpuSize = 0;
+  _uploaded = 0;
+}
@@ -0,0 +1,36 @@
+/*!\file ubo.h
+ *
+ * \brief tampon uniforme par frame : les matrices de chaque objet
+ * (modelView, MVP et normales) sont calculées une fois côté CPU, rangées
+ * à des décalages alignés puis envoyées en un seul transfert.
+ * \author Lucien Cartier
+ */
+
+#ifndef _UBO_H
+
+#define _UBO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /* copie CPU des blocs d'une frame, préparable hors du thread OpenGL */
+  typedef struct uboFrame uboFrame;
+
+  extern void uboInit(void);
+  extern void uboProgram(unsigned int pId);
+  extern uboFrame *uboFrameNew(void);
+  extern void uboFrameFree(uboFrame *f);
+  extern void uboBegin(uboFrame *f, const float *projection);
+  extern unsigned int uboReserve(uboFrame *f, unsigned int n);
+  extern void uboSet(uboFrame *f, unsigned int object, const float *modelView);
+  extern unsigned int uboPush(uboFrame *f, const float *modelView);
+  extern void uboUpload(const uboFrame *f);
+  extern void uboBind(unsigned int object);
+  extern void uboQuit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
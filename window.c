@@ -1,3 +1,11 @@
+#include "dynres.h"
+#include "jobs.h"
+#include "kernels.h"
+#include "mat4.h"
+#include "pack.h"
+#include "raster.h"
+#include "spectrum.h"
+#include "ubo.h"
 #include <GL4D/gl4df.h>
 #include <GL4D/gl4dp.h>
 #include <GL4D/gl4du.h>
@@ -10,6 +18,8 @@
 #include <fftw3.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /*****************************************************************************/
 /*                                 constants                                 */
@@ -20,6 +30,8 @@
 #define LIMIT_HIGH 500
 #define END_CREDITS 14700.0
 #define END_MUSIC 302000.0
+#define HEADLESS_FPS 25
+#define PACK_FILE "ALYS_squares.pack"
 
 /*****************************************************************************/
 /*                                 functions                                 */
@@ -27,7 +39,12 @@
 
 /* assimp functions **********************************************************/
 extern void assimpInit(const char *filename);
-extern void assimpDrawScene(void);
+extern void assimpInitRaster(const char *filename);
+extern unsigned int assimpNbMeshes(void);
+extern void assimpPrepareScene(int slot, const float *proj, const float *mv,
+                               uboFrame *f, unsigned int base);
+extern void assimpDrawScene(int slot);
+extern void assimpRasterScene(void);
 extern void assimpQuit(void);
 
 /* audio functions ***********************************************************/
@@ -36,12 +53,29 @@ static void mixCallback(void *udata, Uint8 *stream, int len);
 
 /* general functions *********************************************************/
 static void init(void);
+static GLuint createProgram(const char *vs, const char *fs);
 static void resize(int w, int h);
 static void loadTexture(GLuint id, const char *filename);
 static void initText(GLuint *ptId, const char *text);
+static void animate(GLfloat time);
+static int finished(GLfloat time);
+static void advance(void);
 static void draw(void);
 static void quit(void);
 
+/* préparation des frames (jobs.c) *******************************************/
+static void kickFrame(int slot);
+static void prepareFrame(void *arg);
+static void prepareObjects(void *arg);
+static void prepareScene(void *arg);
+
+/* backend CPU ***************************************************************/
+static void initRaster(void);
+static void drawRaster(GLfloat time);
+static void drawCPU(void);
+static int headless(void);
+static int framePattern(const char *pattern);
+
 /*****************************************************************************/
 /*                                 variables                                 */
 /*****************************************************************************/
@@ -49,14 +83,45 @@ static void quit(void);
 /* textures ******************************************************************/
 static GLuint _tId = 0; /* texture pour les carrés */
 
+/* backend de rendu, choisi via la variable d'environnement SQUARES_BACKEND
+ * ("gl" par défaut, "cpu" ou "headless") */
+enum { BACKEND_GL = 0, BACKEND_CPU, BACKEND_HEADLESS };
+static int _backend = BACKEND_GL;
+static SDL_Surface *_rSquare = NULL; /* texture des carrés côté CPU */
+static rasterTexture _rSquareTex;
+
+/* animation *****************************************************************/
+static GLfloat _xz = 0, _y = 0, _shiftx = 0, _shifty = 0, _shiftz = 0,
+               _rotCamera = 0, _modShift = 0;
+static GLfloat _basses = 0, _high = 0, _volume = 0;
+
 /* OpenGL and GL4D ***********************************************************/
 static int _wW = 800, _wH = 800;
 static GLuint _pId = 0, _pId2 = 0, _pId3 = 0; /* id programme GLSL */
 static GLuint _cube1 = 0, _cube2 = 0, _cube3 = 0, _cube = 0, _quad = 0,
               _textTexId = 0;
+/* piles de matrices (mat4.c) */
+static unsigned int _modelView = 0, _projection = 0;
+
+/* frames en vol : pendant que le thread principal soumet l'une, les workers
+ * préparent l'autre (animation, matrices, listes de dessin) */
+#define NB_FRAMES 2
+typedef struct frame_t frame_t;
+struct frame_t {
+  int slot, finished;
+  GLfloat time, basses;
+  GLfloat projection[16], view[16], sceneView[16];
+  unsigned int cubes[4], credits, scene;
+  uboFrame *ubo;
+  jobCounter done;
+};
+static frame_t _frames[NB_FRAMES];
+static int _frame = 0; /* frame à soumettre au prochain draw() */
 
 /* audio *********************************************************************/
 static Sint16 _hauteurs[ECHANTILLONS]; /* résultat de l'analyse FFT */
+/* amplitudes seules, sans réplication, envoyées au GPU (spectrum.c) */
+static float _amplitudes[ECHANTILLONS / 4];
 /* pointeur vers la musique chargée par SDL_Mixer */
 static Mix_Music *_mmusic = NULL;
 /* données entrées/sorties pour la lib fftw */
@@ -73,34 +138,65 @@ static fftw_plan _plan4fftw = NULL;
 /*****************************************************************************/
 
 int main(int argc, char **argv) {
+  const char *backend = getenv("SQUARES_BACKEND"),
+             *pack = getenv("SQUARES_PACK");
+  if (backend && !strcmp(backend, "cpu"))
+    _backend = BACKEND_CPU;
+  else if (backend && !strcmp(backend, "headless"))
+    _backend = BACKEND_HEADLESS;
+  else if (backend && strcmp(backend, "gl"))
+    fprintf(stderr, "SQUARES_BACKEND: backend %s inconnu, utilisation de GL\n",
+            backend);
+  /* toutes les ressources depuis une seule archive, si elle existe */
+  packInit(pack ? pack : PACK_FILE);
+  if (_backend == BACKEND_HEADLESS)
+    return headless();
+
   if (!gl4duwCreateWindow(argc, argv, "GL4Dummies", 0, 0, _wW, _wH,
                           GL4DW_RESIZABLE | GL4DW_SHOWN))
     return 1;
 
-  assimpInit("models/ALYS_ShapeChange.obj");
-  init();
   atexit(quit);
-  gl4duwResizeFunc(resize);
-  gl4duwDisplayFunc(draw);
+  if (_backend == BACKEND_CPU) {
+    initRaster();
+    initAudio("audio/musique.mp3");
+    gl4duwDisplayFunc(drawCPU);
+  } else {
+    assimpInit("models/ALYS_ShapeChange.obj");
+    init();
+    gl4duwResizeFunc(resize);
+    gl4duwDisplayFunc(draw);
+  }
   gl4duwMainLoop();
   return 0;
 }
 
 /* init de OpenGL */
 static void init(void) {
+  int i;
   /* shaders *****************************************************************/
   glEnable(GL_DEPTH_TEST);
   glClearColor(0.0824f, 0.0824f, 0.0824f, 0.0f);
-  _pId =
-      gl4duCreateProgram("<vs>shaders/model.vs", "<fs>shaders/model.fs", NULL);
-  _pId2 =
-      gl4duCreateProgram("<vs>shaders/model.vs", "<fs>shaders/model.fs", NULL);
-  _pId3 = gl4duCreateProgram("<vs>shaders/credits.vs", "<fs>shaders/credits.fs",
-                             NULL);
-  gl4duGenMatrix(GL_FLOAT, "modelViewMatrix");
-  gl4duGenMatrix(GL_FLOAT, "projectionMatrix");
+  _pId = createProgram("shaders/model.vs", "shaders/model.fs");
+  _pId2 = createProgram("shaders/model.vs", "shaders/model.fs");
+  _pId3 = createProgram("shaders/credits.vs", "shaders/credits.fs");
+  /* les carrés partagent le shader du modèle sans ses matériaux */
+  glUseProgram(_pId);
+  glUniform1f(glGetUniformLocation(_pId, "opacity"), 1.0f);
+  glUseProgram(0);
+  _modelView = mat4GenStack();
+  _projection = mat4GenStack();
+  uboInit();
+  uboProgram(_pId);
+  uboProgram(_pId2);
+  uboProgram(_pId3);
+  spectrumInit();
+  spectrumProgram(_pId);
+  spectrumProgram(_pId2);
+  spectrumProgram(_pId3);
   glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
+  dynresInit(_wW, _wH);
   resize(_wW, _wH);
 
   /* textures ****************************************************************/
@@ -114,16 +210,16 @@ static void init(void) {
   _cube1 = gl4dgGenCubef();
 
   /* audio *******************************************************************/
-  _in4fftw = fftw_malloc(ECHANTILLONS * sizeof *_in4fftw);
-  memset(_in4fftw, 0, ECHANTILLONS * sizeof *_in4fftw);
-  assert(_in4fftw);
-  _out4fftw = fftw_malloc(ECHANTILLONS * sizeof *_out4fftw);
-  assert(_out4fftw);
-  _plan4fftw = fftw_plan_dft_1d(ECHANTILLONS, _in4fftw, _out4fftw, FFTW_FORWARD,
-                                FFTW_ESTIMATE);
-  assert(_plan4fftw);
   initAudio("audio/musique.mp3");
 
+  /* frames ******************************************************************/
+  jobsInit(0);
+  for (i = 0; i < NB_FRAMES; ++i) {
+    _frames[i].slot = i;
+    _frames[i].ubo = uboFrameNew();
+  }
+  kickFrame(0);
+
   /* text ********************************************************************/
   _quad = gl4dgGenQuadf();
   initText(&_textTexId, "        Modèle 3D :\n"
@@ -135,12 +231,21 @@ static void init(void) {
                         "Lucien Cartier");
 }
 
+/* sources depuis l'archive des ressources, ou depuis les fichiers */
+static GLuint createProgram(const char *vs, const char *fs) {
+  char *vsArg = packShader("vs", vs), *fsArg = packShader("fs", fs);
+  GLuint pId = gl4duCreateProgram(vsArg, fsArg, NULL);
+  free(vsArg);
+  free(fsArg);
+  return pId;
+}
+
 static void loadTexture(GLuint id, const char *filename) {
   SDL_Surface *t;
   glBindTexture(GL_TEXTURE_2D, id);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  if ((t = IMG_Load(filename)) != NULL) {
+  if ((t = IMG_Load_RW(packRW(filename), 1)) != NULL) {
 #ifdef __APPLE__
     int mode = t->format->BytesPerPixel == 4 ? GL_BGRA : GL_BGR;
 #else
@@ -179,7 +284,7 @@ static void initText(GLuint *ptId, const char *text) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   }
   /* chargement de la font */
-  if (!(font = TTF_OpenFont("DejaVuSans-Bold.ttf", 128))) {
+  if (!(font = TTF_OpenFontRW(packRW("DejaVuSans-Bold.ttf"), 1, 128))) {
     fprintf(stderr, "TTF_OpenFont: %s\n", TTF_GetError());
     return;
   }
@@ -213,6 +318,14 @@ static void initAudio(const char *filename) {
   int mult = 2;
 #endif
   int mixFlags = MIX_INIT_MP3, res;
+  _in4fftw = fftw_malloc(ECHANTILLONS * sizeof *_in4fftw);
+  memset(_in4fftw, 0, ECHANTILLONS * sizeof *_in4fftw);
+  assert(_in4fftw);
+  _out4fftw = fftw_malloc(ECHANTILLONS * sizeof *_out4fftw);
+  assert(_out4fftw);
+  _plan4fftw = fftw_plan_dft_1d(ECHANTILLONS, _in4fftw, _out4fftw, FFTW_FORWARD,
+                                FFTW_ESTIMATE);
+  assert(_plan4fftw);
   res = Mix_Init(mixFlags);
   if ((res & mixFlags) != mixFlags) {
     fprintf(stderr, "Mix_Init: Erreur lors de l'initialisation de la "
@@ -221,7 +334,8 @@ static void initAudio(const char *filename) {
   }
   if (Mix_OpenAudio(44100, AUDIO_S16LSB, 1, mult * ECHANTILLONS) < 0)
     exit(4);
-  if (!(_mmusic = Mix_LoadMUS(filename))) {
+  /* lue au fil de la lecture : l'archive reste projetée jusqu'à quit */
+  if (!(_mmusic = Mix_LoadMUS_RW(packRW(filename), 1))) {
     fprintf(stderr, "Erreur lors du Mix_LoadMUS: %s\n", Mix_GetError());
     exit(5);
   }
@@ -231,19 +345,12 @@ static void initAudio(const char *filename) {
 }
 
 static void mixCallback(void *udata, Uint8 *stream, int len) {
+  int n = MIN(len >> 1, ECHANTILLONS);
   if (_plan4fftw) {
-    int i, j, l = MIN(len >> 1, ECHANTILLONS);
-    Sint16 *d = (Sint16 *)stream;
-    for (i = 0; i < l; i++)
-      _in4fftw[i][0] = d[i] / ((1 << 15) - 1.0);
-    fftw_execute(_plan4fftw);
-    for (i = 0; i<l>> 2; i++) {
-      _hauteurs[4 * i] = (int)(sqrt(_out4fftw[i][0] * _out4fftw[i][0] +
-                                    _out4fftw[i][1] * _out4fftw[i][1]) *
-                               exp(2.0 * i / (double)(l / 4.0)));
-      for (j = 1; j < 4; j++)
-        _hauteurs[4 * i + j] = MIN(_hauteurs[4 * i], 255);
-    }
+    kernelSpectrum((Sint16 *)stream, n, _plan4fftw, _in4fftw, _out4fftw,
+                   _hauteurs, _amplitudes);
+    /* sans effet hors backend GL */
+    spectrumPush(_amplitudes, n >> 2);
   }
 }
 
@@ -251,127 +358,192 @@ static void resize(int w, int h) {
   _wW = w;
   _wH = h;
   glViewport(0, 0, _wW, _wH);
-  gl4duBindMatrix("projectionMatrix");
-  gl4duLoadIdentityf();
-  gl4duFrustumf(-0.5, 0.5, -0.5 * _wH / _wW, 0.5 * _wH / _wW, 1.0, 1000.0);
-  gl4duBindMatrix("modelViewMatrix");
+  dynresResize(_wW, _wH);
+  mat4LoadIdentity(_projection);
+  mat4Frustum(_projection, -0.5, 0.5, -0.5 * _wH / _wW, 0.5 * _wH / _wW, 1.0,
+              1000.0);
 }
 
-static void draw(void) {
-
-  static GLfloat xz = 0, y = 0, shiftx = 0, shifty = 0, shiftz = 0,
-                 rot_camera = 0, mod_shift = 0;
-  static GLfloat basses = 0, high = 0, volume = 0;
+/* analyse audio et mise à jour de l'animation, communes à tous les
+ * backends */
+static void animate(GLfloat time) {
   const float shift_coef = 0.02f;
-  GLfloat lum[4] = {0.0, 0.0, 5.0, 1.0};
-  static GLfloat t0 = -1;
-  GLfloat t, d, time;
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  time = SDL_GetTicks();
 
   /***************************************************************************/
   /*                              analyse audio                              */
   /***************************************************************************/
 
-  for (int i = 0; i < ECHANTILLONS; ++i) {
-    volume += (float)_hauteurs[i];
-  }
-  volume /= (float)ECHANTILLONS;
-  printf("time %f\tvolume %f\n", time, volume);
+  _volume = kernelBand(_volume, _hauteurs, 0, ECHANTILLONS);
+  printf("time %f\tvolume %f\n", time, _volume);
 
-  if(time > END_CREDITS && volume == 0.0)
-    exit(0);
+  _basses = kernelBand(_basses, _hauteurs, 0, LIMIT_BASS);
+  _xz += _basses * 0.05;
+  _y += _basses * 0.1;
 
-  for (int i = 0; i < LIMIT_BASS; ++i) {
-    basses += (float)_hauteurs[i];
-  }
-  basses /= (float)LIMIT_BASS;
-  xz += basses * 0.05;
-  y += basses * 0.1;
-
-  for (int i = LIMIT_HIGH; i < ECHANTILLONS; ++i) {
-    high += (float)_hauteurs[i];
-  }
-  high /= (float)(ECHANTILLONS - LIMIT_HIGH);
+  _high = kernelBand(_high, _hauteurs, LIMIT_HIGH, ECHANTILLONS);
 
   /***************************************************************************/
   /*                                    3D                                   */
   /***************************************************************************/
 
-  shiftx = ((int)mod_shift % 6 == 0) ? high * shift_coef : shiftx;
-  shifty = ((int)mod_shift % 6 == 1) ? high * shift_coef : shifty;
-  shiftz = ((int)mod_shift % 6 == 2) ? high * shift_coef : shiftz;
-  shiftx = ((int)mod_shift % 6 == 3) ? -high * shift_coef : shiftx;
-  shifty = ((int)mod_shift % 6 == 4) ? -high * shift_coef : shifty;
-  shiftz = ((int)mod_shift % 6 == 5) ? -high * shift_coef : shiftz;
+  _shiftx = ((int)_modShift % 6 == 0) ? _high * shift_coef : _shiftx;
+  _shifty = ((int)_modShift % 6 == 1) ? _high * shift_coef : _shifty;
+  _shiftz = ((int)_modShift % 6 == 2) ? _high * shift_coef : _shiftz;
+  _shiftx = ((int)_modShift % 6 == 3) ? -_high * shift_coef : _shiftx;
+  _shifty = ((int)_modShift % 6 == 4) ? -_high * shift_coef : _shifty;
+  _shiftz = ((int)_modShift % 6 == 5) ? -_high * shift_coef : _shiftz;
+}
 
-  /* squares *****************************************************************/
-  glUseProgram(_pId);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, _tId);
-  glDisable(GL_BLEND);
-  glUniform1i(glGetUniformLocation(_pId, "tex"), 0);
+/* la musique est finie et le silence revenu */
+static int finished(GLfloat time) {
+  return _mmusic && time > END_CREDITS && _volume == 0.0;
+}
+
+static void advance(void) {
+  _xz += 2;
+  _rotCamera += 0.3;
+  _modShift += 0.07;
+}
+
+/* soumet la frame de l'emplacement slot, datée de maintenant */
+static void kickFrame(int slot) {
+  frame_t *f = &_frames[slot];
+  memcpy(f->projection, mat4Top(_projection), sizeof f->projection);
+  f->time = SDL_GetTicks();
+  jobsSubmit("frame", prepareFrame, f, &f->done);
+}
 
-  gl4duBindMatrix("modelViewMatrix");
-  gl4duLoadIdentityf();
+/* une frame à la fois : animate et advance restent donc séquentiels ; les
+ * objets et la scène sont préparés en parallèle */
+static void prepareFrame(void *arg) {
+  frame_t *f = arg;
+  jobCounter children = {0};
+  unsigned int base;
+  int i;
+
+  animate(f->time);
+  f->finished = finished(f->time);
+  f->basses = _basses;
+
+  uboBegin(f->ubo, f->projection);
+  base = uboReserve(f->ubo, 5);
+  for (i = 0; i < 4; ++i)
+    f->cubes[i] = base + i;
+  f->credits = base + 4;
+  if (f->time > END_CREDITS)
+    f->scene = uboReserve(f->ubo, assimpNbMeshes());
+
+  mat4LoadIdentity(_modelView);
+  mat4Translate(_modelView, 0, -5, -20);
+  mat4Rotate(_modelView, sin(_rotCamera * 0.01) * 40, 0, -1, -0.25);
+  mat4Rotate(_modelView, 20, 1, 0, 0);
+  memcpy(f->view, mat4Top(_modelView), sizeof f->view);
+  mat4Translate(_modelView, -0.7f, -20, -8);
+  mat4Scale(_modelView, 70, 70, 70);
+  mat4Rotate(_modelView, 180, 0, 1, 0);
+  memcpy(f->sceneView, mat4Top(_modelView), sizeof f->sceneView);
+
+  jobsSubmit("objets", prepareObjects, f, &children);
+  if (f->time > END_CREDITS)
+    jobsSubmit("scene", prepareScene, f, &children);
+  jobsWait(&children);
+  advance();
+}
 
-  gl4duTranslatef(0, -5, -20);
-  gl4duRotatef(sin(rot_camera * 0.01) * 40, 0, -1, -0.25);
-  gl4duRotatef(20, 1, 0, 0);
+/* carrés et crédits, seuls utilisateurs de _modelView pendant la frame */
+static void prepareObjects(void *arg) {
+  frame_t *f = arg;
+  mat4Load(_modelView, f->view);
 
-  gl4duPushMatrix();
+  mat4Push(_modelView);
   {
-    gl4duTranslatef(shiftx - 1, shifty - 1, shiftz + 1);
-    gl4duRotatef(-xz, 1, 0, 1);
-    gl4duRotatef(y, 0, 1, 0);
-    gl4duSendMatrices();
+    mat4Translate(_modelView, _shiftx - 1, _shifty - 1, _shiftz + 1);
+    mat4Rotate(_modelView, -_xz, 1, 0, 1);
+    mat4Rotate(_modelView, _y, 0, 1, 0);
+    uboSet(f->ubo, f->cubes[0], mat4Top(_modelView));
   }
-  gl4duPopMatrix();
-  gl4dgDraw(_cube1);
+  mat4Pop(_modelView);
 
-  gl4duPushMatrix();
+  mat4Push(_modelView);
   {
-    gl4duTranslatef(shiftx + 1, shifty + 1.5f, shiftz + 1);
-    gl4duRotatef(-xz, 1, 0, 1);
-    gl4duRotatef(y, 0, 1, 0);
-    gl4duSendMatrices();
+    mat4Translate(_modelView, _shiftx + 1, _shifty + 1.5f, _shiftz + 1);
+    mat4Rotate(_modelView, -_xz, 1, 0, 1);
+    mat4Rotate(_modelView, _y, 0, 1, 0);
+    uboSet(f->ubo, f->cubes[1], mat4Top(_modelView));
   }
-  gl4duPopMatrix();
-  gl4dgDraw(_cube2);
+  mat4Pop(_modelView);
 
-  gl4duPushMatrix();
+  mat4Push(_modelView);
   {
-    gl4duTranslatef(shiftx + 1, shifty - 1, shiftz);
-    gl4duScalef(0.8, 0.8, 0.8);
-    gl4duRotatef(-xz, 1, 0, 1);
-    gl4duRotatef(y, 0, 1, 0);
-    gl4duSendMatrices();
+    mat4Translate(_modelView, _shiftx + 1, _shifty - 1, _shiftz);
+    mat4Scale(_modelView, 0.8, 0.8, 0.8);
+    mat4Rotate(_modelView, -_xz, 1, 0, 1);
+    mat4Rotate(_modelView, _y, 0, 1, 0);
+    uboSet(f->ubo, f->cubes[2], mat4Top(_modelView));
   }
-  gl4duPopMatrix();
-  gl4dgDraw(_cube3);
+  mat4Pop(_modelView);
 
-  gl4duPushMatrix();
+  mat4Push(_modelView);
   {
-    gl4duTranslatef(shiftx, shifty, shiftz + 3);
-    gl4duScalef(0.5f, 0.5f, 0.5f);
-    gl4duRotatef(-xz, 1, 0, 1);
-    gl4duRotatef(y, 0, 1, 0);
-    gl4duSendMatrices();
+    mat4Translate(_modelView, _shiftx, _shifty, _shiftz + 3);
+    mat4Scale(_modelView, 0.5f, 0.5f, 0.5f);
+    mat4Rotate(_modelView, -_xz, 1, 0, 1);
+    mat4Rotate(_modelView, _y, 0, 1, 0);
+    uboSet(f->ubo, f->cubes[3], mat4Top(_modelView));
   }
-  gl4duPopMatrix();
-  gl4dgDraw(_cube);
+  mat4Pop(_modelView);
 
-  gl4dfBlur(0, 0, (int)basses / 20, 1, 0, GL_FALSE);
-  gl4duTranslatef(-0.7f, -20, -8);
-  gl4duScalef(70, 70, 70);
+  if (f->time <= END_CREDITS) {
+    mat4LoadIdentity(_modelView);
+    mat4Translate(_modelView, -0.4, 0.4, -3);
+    uboSet(f->ubo, f->credits, mat4Top(_modelView));
+  }
+}
 
-  gl4duSendMatrices();
+static void prepareScene(void *arg) {
+  frame_t *f = arg;
+  assimpPrepareScene(f->slot, f->projection, f->sceneView, f->ubo, f->scene);
+}
+
+/* soumet la frame préparée pendant la précédente, après avoir lancé la
+ * préparation de la suivante : l'animation a donc une frame de retard */
+static void draw(void) {
+  GLfloat lum[4] = {0.0, 0.0, 5.0, 1.0};
+  static GLfloat t0 = -1;
+  frame_t *f = &_frames[_frame];
+  jobsWait(&f->done);
+  if (f->finished)
+    exit(0);
+  _frame = (_frame + 1) % NB_FRAMES;
+  kickFrame(_frame);
+
+  dynresBegin();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  uboUpload(f->ubo);
+  spectrumUpload();
+
+  /* squares *****************************************************************/
+  glUseProgram(_pId);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, _tId);
+  glDisable(GL_BLEND);
+  glUniform1i(glGetUniformLocation(_pId, "tex"), 0);
+
+  uboBind(f->cubes[0]);
+  gl4dgDraw(_cube1);
+  uboBind(f->cubes[1]);
+  gl4dgDraw(_cube2);
+  uboBind(f->cubes[2]);
+  gl4dgDraw(_cube3);
+  uboBind(f->cubes[3]);
+  gl4dgDraw(_cube);
+
+  gl4dfBlur(0, 0, (int)f->basses / 20, 1, 0, GL_FALSE);
 
   /* credits *****************************************************************/
   if (t0 < 0.0f)
     t0 = SDL_GetTicks();
-  if(time <= END_CREDITS) {
+  if(f->time <= END_CREDITS) {
     glUseProgram(_pId3);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -381,16 +553,8 @@ static void draw(void) {
     glUniform1i(glGetUniformLocation(_pId3, "inv"), 1);
     glUniform1i(glGetUniformLocation(_pId3, "tex"), 0);
     glUniform1f(glGetUniformLocation(_pId3, "alpha"),
-                1.0f - fabsf(cos((time / 14800.0) * M_PI)));
-    gl4duBindMatrix("modelViewMatrix");
-    gl4duLoadIdentityf();
-    gl4duPushMatrix();
-    {
-      gl4duTranslatef(-0.4, 0.4, -3);
-      gl4duScalef(1.0f, 1.0f, 1.0f);
-      gl4duSendMatrices();
-    }
-    gl4duPopMatrix();
+                1.0f - fabsf(cos((f->time / 14800.0) * M_PI)));
+    uboBind(f->credits);
     gl4dgDraw(_quad);
     glUseProgram(0);
   }
@@ -398,27 +562,20 @@ static void draw(void) {
   /* ALYS ********************************************************************/
 
   glUseProgram(_pId2);
-  glEnable(GL_BLEND);
+  /* le mélange n'est activé que pour les maillages translucides */
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glUniform4fv(glGetUniformLocation(_pId2, "lumpos"), 1, lum);
   glEnable(GL_CULL_FACE);
-  gl4duPushMatrix();
-  {
+  if(f->time > END_CREDITS)
+    assimpDrawScene(f->slot);
 
-    gl4duSendMatrices();
-  }
-  gl4duPopMatrix();
-  gl4duRotatef(180, 0, 1, 0);
-  if(time > END_CREDITS)
-    assimpDrawScene();
-  gl4duSendMatrices();
-
-  xz += 2;
-  rot_camera += 0.3;
-  mod_shift += 0.07;
+  dynresEnd();
 }
 
 static void quit(void) {
+  int i;
+  /* plus aucune tâche ne doit tourner quand les ressources sont libérées */
+  jobsQuit();
   if (_mmusic) {
     if (Mix_PlayingMusic())
       Mix_HaltMusic();
@@ -444,5 +601,182 @@ static void quit(void) {
     _textTexId = 0;
   }
   assimpQuit();
-  gl4duClean(GL4DU_ALL);
+  if (_backend == BACKEND_GL) {
+    dynresQuit();
+    uboQuit();
+    spectrumQuit();
+    for (i = 0; i < NB_FRAMES; ++i) {
+      uboFrameFree(_frames[i].ubo);
+      _frames[i].ubo = NULL;
+    }
+    if (_modelView) {
+      mat4DeleteStack(_modelView);
+      mat4DeleteStack(_projection);
+      _modelView = _projection = 0;
+    }
+  } else {
+    rasterQuit();
+    if (_rSquare) {
+      SDL_FreeSurface(_rSquare);
+      _rSquare = NULL;
+    }
+  }
+  /* aucun contexte OpenGL n'existe en mode headless */
+  if (_backend != BACKEND_HEADLESS)
+    gl4duClean(GL4DU_ALL);
+  /* après la musique, lue dans l'archive jusqu'au bout */
+  packQuit();
+}
+
+/*****************************************************************************/
+/*                                backend CPU                                */
+/*****************************************************************************/
+
+/* n'utilise aucun appel OpenGL : le framebuffer est soit recopié dans
+ * l'écran gl4dp (backend "cpu"), soit exporté (backend "headless") */
+static void initRaster(void) {
+  SDL_Surface *t;
+  int w = _wW, h = _wH;
+  if (_backend == BACKEND_CPU) {
+    gl4dpInitScreen();
+    w = gl4dpGetWidth();
+    h = gl4dpGetHeight();
+  }
+  if (!rasterInit(w, h, 0)) {
+    fprintf(stderr, "rasterInit: impossible d'allouer le framebuffer\n");
+    exit(6);
+  }
+  rasterBindMatrix(RASTER_PROJECTION);
+  rasterLoadIdentity();
+  rasterFrustum(-0.5, 0.5, -0.5 * h / w, 0.5 * h / w, 1.0, 1000.0);
+  rasterBindMatrix(RASTER_MODELVIEW);
+  if ((t = IMG_Load_RW(packRW("images/square.jpg"), 1)) != NULL) {
+    _rSquare = SDL_ConvertSurfaceFormat(t, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(t);
+  }
+  if (_rSquare) {
+    _rSquareTex.w = _rSquare->w;
+    _rSquareTex.h = _rSquare->h;
+    _rSquareTex.pitch = _rSquare->pitch / 4;
+    _rSquareTex.texels = _rSquare->pixels;
+  } else
+    fprintf(stderr, "can't open file %s : %s\n", "images/square.jpg",
+            SDL_GetError());
+  assimpInitRaster("models/ALYS_ShapeChange.obj");
+}
+
+/* même scène que draw(), sans le flou ni les crédits */
+static void drawRaster(GLfloat time) {
+  animate(time);
+  if (finished(time))
+    exit(0);
+  rasterClear(0x00151515);
+
+  /* squares *****************************************************************/
+  rasterBlend(0);
+  rasterBindTexture(_rSquare ? &_rSquareTex : NULL);
+  rasterBindMatrix(RASTER_MODELVIEW);
+  rasterLoadIdentity();
+
+  rasterTranslate(0, -5, -20);
+  rasterRotate(sin(_rotCamera * 0.01) * 40, 0, -1, -0.25);
+  rasterRotate(20, 1, 0, 0);
+
+  rasterPushMatrix();
+  rasterTranslate(_shiftx - 1, _shifty - 1, _shiftz + 1);
+  rasterRotate(-_xz, 1, 0, 1);
+  rasterRotate(_y, 0, 1, 0);
+  rasterDrawCube();
+  rasterPopMatrix();
+
+  rasterPushMatrix();
+  rasterTranslate(_shiftx + 1, _shifty + 1.5f, _shiftz + 1);
+  rasterRotate(-_xz, 1, 0, 1);
+  rasterRotate(_y, 0, 1, 0);
+  rasterDrawCube();
+  rasterPopMatrix();
+
+  rasterPushMatrix();
+  rasterTranslate(_shiftx + 1, _shifty - 1, _shiftz);
+  rasterScale(0.8, 0.8, 0.8);
+  rasterRotate(-_xz, 1, 0, 1);
+  rasterRotate(_y, 0, 1, 0);
+  rasterDrawCube();
+  rasterPopMatrix();
+
+  rasterPushMatrix();
+  rasterTranslate(_shiftx, _shifty, _shiftz + 3);
+  rasterScale(0.5f, 0.5f, 0.5f);
+  rasterRotate(-_xz, 1, 0, 1);
+  rasterRotate(_y, 0, 1, 0);
+  rasterDrawCube();
+  rasterPopMatrix();
+
+  /* ALYS ********************************************************************/
+  rasterTranslate(-0.7f, -20, -8);
+  rasterScale(70, 70, 70);
+  rasterRotate(180, 0, 1, 0);
+  rasterBlend(1);
+  if (time > END_CREDITS)
+    assimpRasterScene();
+
+  rasterFlush();
+  advance();
+}
+
+static void drawCPU(void) {
+  int w, h;
+  GLuint *pixels = rasterGetPixels(&w, &h);
+  drawRaster(SDL_GetTicks());
+  memcpy(gl4dpGetPixels(), pixels, w * h * sizeof *pixels);
+  gl4dpUpdateScreen(NULL);
+}
+
+/* rendu sans fenêtre ni contexte OpenGL, à pas de temps fixe et sans audio ;
+ * HEADLESS_FRAMES et HEADLESS_OUTPUT (motif printf avec une seule
+ * conversion entière, le numéro de frame) peuvent être définis */
+static int headless(void) {
+  const char *env, *pattern = "frame%05d.ppm";
+  char filename[BUFSIZ];
+  int i, nbFrames = (int)(END_MUSIC / 1000.0 * HEADLESS_FPS);
+  if ((env = getenv("HEADLESS_FRAMES")) != NULL)
+    nbFrames = atoi(env);
+  if ((env = getenv("HEADLESS_OUTPUT")) != NULL) {
+    if (!framePattern(env)) {
+      fprintf(stderr, "HEADLESS_OUTPUT: %s doit contenir exactement une "
+                      "conversion entière (%%d, %%05d, ...)\n", env);
+      return 8;
+    }
+    pattern = env;
+  }
+  atexit(quit);
+  initRaster();
+  for (i = 0; i < nbFrames; ++i) {
+    drawRaster(i * 1000.0f / HEADLESS_FPS);
+    snprintf(filename, sizeof filename, pattern, i);
+    if (!rasterExport(filename))
+      return 7;
+  }
+  return 0;
+}
+
+/* le motif est passé tel quel à snprintf : seuls sont admis les %% et une
+ * unique conversion %d ou %i, avec drapeaux, largeur et précision */
+static int framePattern(const char *pattern) {
+  const char *p;
+  int nb = 0;
+  for (p = pattern; *p; ++p) {
+    if (*p != '%')
+      continue;
+    if (*++p == '%')
+      continue;
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789");
+    if (*p == '.')
+      p += 1 + strspn(p + 1, "0123456789");
+    if (*p != 'd' && *p != 'i')
+      return 0;
+    nb++;
+  }
+  return nb == 1;
 }